@@ -9,10 +9,11 @@
 #define BLOCKING -1
 #define POLL_TIMEOUT_MS 10
 #define SERVER_PORT 8080
+#define MAX_DATAGRAM_SIZE 2048
 
 Client::Client()
-    : tcpSocket(-1), udpSocket(-1), localServerPid(0), serverClientPipe{-1, -1}, clientServerPipe{-1, -1}, gameData(nullptr),
-      stopFlag(false) {}
+    : tcpSocket(-1), udpSocket(-1), localServerPid(0), serverClientPipe{-1, -1}, clientServerPipe{-1, -1},
+      playerId(0), sessionToken(0), stopFlag(false) {}
 
 Client::~Client() {
   if (this->localServerPid > 0) 
@@ -59,14 +60,21 @@ void Client::initConnections(const std::string& serverIP) {
 
   std::cout << "Connected" << std::endl;
 
-  this->serverFd.fd = this->tcpSocket;
-  this->serverFd.events = POLLIN;
-  this->serverFd.revents = 0;
+  this->serverFds[0].fd = this->tcpSocket;
+  this->serverFds[1].fd = this->udpSocket;
+  for (auto& serverFd : this->serverFds) {
+    serverFd.events = POLLIN;
+    serverFd.revents = 0;
+  }
+
+  sendHello();
 }
 
 void Client::start(const std::string& serverIP, bool isSinglePlayer) {
   try {
     this->stopFlag.store(false);
+    this->playerId.store(0);
+    this->sessionToken.store(0);
 
     if (isSinglePlayer && !this->localServerPid) {
       this->startLocalServer();
@@ -75,9 +83,11 @@ void Client::start(const std::string& serverIP, bool isSinglePlayer) {
 
     this->initConnections(serverIP);
 
-    while (poll(&this->serverFd, 1, BLOCKING)) {
-      if (this->serverFd.revents & POLLIN)
+    while (poll(this->serverFds, 2, BLOCKING)) {
+      if (this->serverFds[0].revents & POLLIN)
         receiveGameData();
+      if (this->serverFds[1].revents & POLLIN)
+        receiveDatagrams();
 
       if (stopFlag.load())
         throw "Stop flag is set";
@@ -96,15 +106,28 @@ void Client::start(const std::string& serverIP, bool isSinglePlayer) {
   {
     std::lock_guard<std::mutex> lock(gameDataMutex);
     std::lock_guard<std::mutex> lock2(mapDataMutex);
-    gameData = nullptr;
-    mapData = nullptr;
-    mapDataBuffer.clear();
-    gameDataBuffer.clear();
+    gameStates.clear();
+    mapState.tiles.clear();
   }
 
   closeSockets();
 }
 
+void writeExact(int fd, const uint8_t* buffer, size_t n) {
+  size_t totalWritten = 0;
+  while (totalWritten < n) {
+    ssize_t bytesWritten = write(fd, buffer + totalWritten, n - totalWritten);
+    if (bytesWritten < 0) {
+      if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)
+        continue; // try again
+      perror("write");
+      throw "Error writing to server";
+    }
+
+    totalWritten += bytesWritten;
+  }
+}
+
 void readExact(int fd, uint8_t* buffer, size_t n) {
   size_t totalRead = 0;
   while (totalRead < n) {
@@ -135,26 +158,68 @@ void Client::receiveGameData() {
   std::vector<uint8_t> buffer(size);
   readExact(tcpSocket, buffer.data(), size);
 
-  saveData(buffer.data(), buffer.size());
+  saveData(buffer.data());
+
+  // snapshots still on TCP, the bind datagram has not made it to the server yet
+  if (this->sessionToken.load() && GetPacket(buffer.data())->type() != MsgType_Map)
+    sendBind();
 }
 
-void Client::saveData(const uint8_t* data, size_t size) {
+// UDP snapshots. Anything not from the server or not a snapshot is dropped, reordered ones are
+// dropped by their tick like on TCP.
+void Client::receiveDatagrams() {
+  uint8_t buffer[MAX_DATAGRAM_SIZE];
+  sockaddr_in sender;
+  socklen_t senderLen;
+
+  while (true) {
+    senderLen = sizeof(sender);
+    ssize_t n = recvfrom(this->udpSocket, buffer, sizeof(buffer), MSG_DONTWAIT, (sockaddr*)&sender, &senderLen);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n < 0)
+      return;
+
+    if (sender.sin_addr.s_addr != this->serverAddr.sin_addr.s_addr || sender.sin_port != this->serverAddr.sin_port)
+      continue;
+
+    flatbuffers::Verifier verifier(buffer, n);
+    if (!VerifyPacketBuffer(verifier))
+      continue;
+
+    MsgType type = GetPacket(buffer)->type();
+    if (type == MsgType_Game || type == MsgType_Delta)
+      saveData(buffer);
+  }
+}
+
+void Client::saveData(const uint8_t* data) {
   const Packet* packet = GetPacket(data);
   switch (packet->type()) {
   case MsgType_Game: {
-    std::lock_guard<std::mutex> lock(gameDataMutex);
-
-    gameDataBuffer.assign(data, data + size);
-    const Packet* pckt = GetPacket(gameDataBuffer.data());
-    gameData = pckt->data_as_GameData();
+    const GameData* gameData = packet->data_as_GameData();
+    if (gameData && saveGameData(gameData))
+      sendAck(gameData->tick());
+    break;
+  }
+  case MsgType_Delta: {
+    const GameDelta* gameDelta = packet->data_as_GameDelta();
+    if (gameDelta && saveGameDelta(gameDelta))
+      sendAck(gameDelta->tick());
+    break;
+  }
+  case MsgType_Welcome: {
+    const Welcome* welcome = packet->data_as_Welcome();
+    if (welcome) {
+      playerId.store(welcome->player_id());
+      sessionToken.store(welcome->token());
+    }
     break;
   }
   case MsgType_Map: {
-    std::lock_guard<std::mutex> lock(mapDataMutex);
-
-    mapDataBuffer.assign(data, data + size);
-    const Packet* pckt = GetPacket(mapDataBuffer.data());
-    mapData = pckt->data_as_MapData();
+    const MapData* mapData = packet->data_as_MapData();
+    if (!mapData || !saveMapData(mapData))
+      std::cerr << "Invalid map" << '\n';
     break;
   }
   default:
@@ -162,14 +227,228 @@ void Client::saveData(const uint8_t* data, size_t size) {
   }
 }
 
+static void pushGameState(std::deque<GameState>& gameStates, GameState&& state) {
+  gameStates.push_back(std::move(state));
+  if (gameStates.size() > GAME_STATE_HISTORY)
+    gameStates.pop_front();
+}
+
+// Packed tiles or one Row per line, both end up in a flat grid
+bool Client::saveMapData(const MapData* mapData) {
+  MapState state{0, 0, {}};
+
+  // servers without Welcome embed the id in the map
+  if (mapData->player_id())
+    playerId.store(mapData->player_id());
+
+  if (mapData->tiles()) {
+    state.width = mapData->width();
+    state.height = mapData->height();
+
+    auto tiles = mapData->tiles();
+    size_t count = (size_t)state.width * state.height;
+    if (tiles->size() < (count + 3) / 4)
+      return false;
+
+    state.tiles.reserve(count);
+    for (size_t i = 0; i < count; i++)
+      state.tiles.push_back(static_cast<Tile>((tiles->Get(i / 4) >> (i % 4 * 2)) & 0x3));
+  } else if (mapData->map()) {
+    auto map = mapData->map();
+    state.height = map->size();
+    state.width = state.height ? map->Get(0)->row()->size() : 0;
+
+    for (auto row = map->begin(); row != map->end(); ++row) {
+      if ((int)row->row()->size() != state.width)
+        return false;
+      for (auto tile = row->row()->begin(); tile != row->row()->end(); ++tile)
+        state.tiles.push_back(static_cast<Tile>(*tile));
+    }
+  }
+
+  if (state.tiles.empty())
+    return false;
+
+  std::lock_guard<std::mutex> lock(mapDataMutex);
+  mapState = std::move(state);
+  return true;
+}
+
+static void readPositions(const flatbuffers::Vector<const Pos*>* positions, std::vector<Vec2i>& body) {
+  if (!positions)
+    return;
+  for (auto part = positions->begin(); part != positions->end(); ++part)
+    body.push_back({part->x(), part->y()});
+}
+
+// Walks the 2-bit direction chain from the head towards the tail
+static bool unpackBody(const PackedBody* packed, std::vector<Vec2i>& body) {
+  if (!packed->head() || !packed->length())
+    return false;
+
+  auto directions = packed->directions();
+  if (!directions || directions->size() < (packed->length() - 1 + 3) / 4)
+    return false;
+
+  Vec2i part = {packed->head()->x(), packed->head()->y()};
+  body.reserve(body.size() + packed->length());
+  body.push_back(part);
+
+  for (uint32_t i = 1; i < packed->length(); i++) {
+    switch ((directions->Get((i - 1) / 4) >> ((i - 1) % 4 * 2)) & 0x3) {
+    case Direction_Up:
+      part.y -= 1;
+      break;
+    case Direction_Down:
+      part.y += 1;
+      break;
+    case Direction_Left:
+      part.x -= 1;
+      break;
+    case Direction_Right:
+      part.x += 1;
+      break;
+    }
+    body.push_back(part);
+  }
+  return true;
+}
+
+// Neither vector is required by the schema, a packet without one passes the verifier
+bool Client::saveGameData(const GameData* gameData) {
+  if (!gameData->snakes() || !gameData->food())
+    return false;
+
+  GameState state;
+  state.tick = gameData->tick();
+
+  for (auto snake = gameData->snakes()->begin(); snake != gameData->snakes()->end(); ++snake) {
+    SnakeState snakeState{snake->id(), snake->score(), snake->state(), {}};
+    if (snake->packed()) {
+      if (!unpackBody(snake->packed(), snakeState.body))
+        return false;
+    } else
+      readPositions(snake->body(), snakeState.body);
+    state.snakes.push_back(std::move(snakeState));
+  }
+
+  for (auto it = gameData->food()->begin(); it != gameData->food()->end(); ++it)
+    state.food.push_back({it->x(), it->y()});
+
+  std::lock_guard<std::mutex> lock(gameDataMutex);
+
+  // servers without ticks send 0, those snapshots are always the newest
+  if (state.tick && !gameStates.empty() && gameStates.back().tick >= state.tick)
+    return false;
+
+  pushGameState(gameStates, std::move(state));
+  return gameStates.back().tick != 0;
+}
+
+// Rebuilds the snapshot from the base the server diffed against
+bool Client::saveGameDelta(const GameDelta* gameDelta) {
+  if (!gameDelta->snakes() || !gameDelta->food())
+    return false;
+
+  std::lock_guard<std::mutex> lock(gameDataMutex);
+
+  if (!gameStates.empty() && gameStates.back().tick >= gameDelta->tick())
+    return false;
+
+  const GameState* base = findGameState(gameDelta->base_tick());
+  if (!base)
+    return false;
+
+  GameState state;
+  state.tick = gameDelta->tick();
+
+  size_t baseIndex = 0;
+  for (auto snake = gameDelta->snakes()->begin(); snake != gameDelta->snakes()->end(); ++snake) {
+    SnakeState snakeState{snake->id(), snake->score(), snake->state(), {}};
+    if (snake->packed()) {
+      if (!snake->reset() || !unpackBody(snake->packed(), snakeState.body))
+        return false;
+    } else
+      readPositions(snake->head(), snakeState.body);
+
+    if (!snake->reset()) {
+      while (baseIndex < base->snakes.size() && base->snakes[baseIndex].id < snake->id())
+        baseIndex++;
+      if (baseIndex == base->snakes.size() || base->snakes[baseIndex].id != snake->id())
+        return false;
+
+      const std::vector<Vec2i>& baseBody = base->snakes[baseIndex].body;
+      if (snake->trim() < 0 || (size_t)snake->trim() > baseBody.size())
+        return false;
+      snakeState.body.insert(snakeState.body.end(), baseBody.begin(), baseBody.end() - snake->trim());
+    }
+
+    state.snakes.push_back(std::move(snakeState));
+  }
+
+  for (auto it = gameDelta->food()->begin(); it != gameDelta->food()->end(); ++it)
+    state.food.push_back({it->x(), it->y()});
+
+  pushGameState(gameStates, std::move(state));
+  return true;
+}
+
+const GameState* Client::findGameState(uint32_t tick) const {
+  for (auto it = gameStates.rbegin(); it != gameStates.rend(); ++it) {
+    if (it->tick == tick)
+      return &*it;
+  }
+  return nullptr;
+}
+
+// TCP, same length-prefixed framing the server uses
+void Client::sendPacket(flatbuffers::FlatBufferBuilder& builder) const {
+  uint32_t netSize = htonl(builder.GetSize());
+  writeExact(tcpSocket, reinterpret_cast<const uint8_t*>(&netSize), sizeof(netSize));
+  writeExact(tcpSocket, builder.GetBufferPointer(), builder.GetSize());
+}
+
+void Client::sendHello() const {
+  flatbuffers::FlatBufferBuilder builder(64);
+
+  auto hello = CreateHello(builder, Feature_DeltaSnapshots | Feature_PackedBodies | Feature_PackedMap |
+                                        Feature_UdpSnapshots);
+  builder.Finish(CreatePacket(builder, MsgType_Hello, MsgUnion_Hello, hello.Union()));
+  sendPacket(builder);
+}
+
+void Client::sendAck(uint32_t tick) const {
+  flatbuffers::FlatBufferBuilder builder(64);
+
+  auto ack = CreateAck(builder, tick);
+  builder.Finish(CreatePacket(builder, MsgType_Ack, MsgUnion_Ack, ack.Union()));
+  sendPacket(builder);
+}
+
+// UDP, the token alone binds this socket as the snapshot endpoint
+void Client::sendBind() const {
+  uint32_t tokenNetwork = htonl(this->sessionToken.load());
+  sendto(this->udpSocket, &tokenNetwork, sizeof(tokenNetwork), 0, (struct sockaddr*)&this->serverAddr,
+         sizeof(this->serverAddr));
+}
+
+// Direction and padding, then the session token so clients sharing an ip are told apart
 void Client::sendDirection(const enum actions newDirection) const {
-  char writeBuf[2];
+  char writeBuf[6];
   writeBuf[0] = newDirection;
   writeBuf[1] = '\0';
 
+  int size = 2;
+  uint32_t token = this->sessionToken.load();
+  if (token) {
+    uint32_t tokenNetwork = htonl(token);
+    memcpy(writeBuf + size, &tokenNetwork, sizeof(tokenNetwork));
+    size += sizeof(tokenNetwork);
+  }
+
   int bytesSent =
-      sendto(this->udpSocket, &writeBuf, 2, 0, (struct sockaddr*)&this->serverAddr, sizeof(this->serverAddr));
-  if (bytesSent != 2) // TODO: retry sending
+      sendto(this->udpSocket, &writeBuf, size, 0, (struct sockaddr*)&this->serverAddr, sizeof(this->serverAddr));
+  if (bytesSent != size) // TODO: retry sending
     std::cout << "Error sending!" << std::endl;
 }
 
@@ -177,14 +456,24 @@ void Client::setStopFlag(bool value) { this->stopFlag.store(value); }
 
 /// GETTERS
 
-const GameData* Client::getGameData() const { return this->gameData; }
+const GameState* Client::getGameState() const {
+  if (this->gameStates.empty())
+    return nullptr;
+  return &this->gameStates.back();
+}
 
-const MapData* Client::getMapData() const { return this->mapData; }
+const MapState* Client::getMapState() const {
+  if (this->mapState.tiles.empty())
+    return nullptr;
+  return &this->mapState;
+}
 
 std::mutex& Client::getGameDataMutex() { return this->gameDataMutex; }
 
 std::mutex& Client::getMapDataMutex() { return this->mapDataMutex; }
 
+int Client::getPlayerId() const { return this->playerId.load(); }
+
 int Client::getStopFlag() const { return this->stopFlag.load(); }
 
 void Client::startLocalServer() {
@@ -2,6 +2,30 @@
 #define CLIENT_HPP
 
 #include "../includes/nibbler.hpp"
+#include <deque>
+
+#define GAME_STATE_HISTORY 32
+
+struct SnakeState {
+  int id;
+  int score;
+  State state;
+  std::vector<Vec2i> body; // head first
+};
+
+// Decoded once on arrival, tiles row-major
+struct MapState {
+  int width;
+  int height;
+  std::vector<Tile> tiles;
+};
+
+// Decoded snapshot, kept so later deltas can be applied on top of it
+struct GameState {
+  uint32_t tick;
+  std::vector<SnakeState> snakes; // sorted by id
+  std::vector<Vec2i> food;
+};
 
 class Client {
 public:
@@ -16,8 +40,9 @@ public:
   void sendDirection(const enum actions newDirection) const;
   void setStopFlag(bool value);
 
-  const GameData* getGameData() const;
-  const MapData* getMapData() const;
+  const GameState* getGameState() const;
+  const MapState* getMapState() const;
+  int getPlayerId() const;
   std::mutex& getGameDataMutex();
   std::mutex& getMapDataMutex();
   int getStopFlag() const;
@@ -26,23 +51,32 @@ private:
   int tcpSocket;
   int udpSocket;
   sockaddr_in serverAddr;
-  struct pollfd serverFd;
+  struct pollfd serverFds[2]; // TCP stream, UDP snapshots
   pid_t localServerPid;
   int serverClientPipe[2];
   int clientServerPipe[2];
 
   // Accessed by drawer thread
   std::mutex gameDataMutex;
-  const GameData* gameData;
-  std::vector<uint8_t> gameDataBuffer;
+  std::deque<GameState> gameStates; // newest at the back
   std::mutex mapDataMutex;
-  const MapData* mapData;
-  std::vector<uint8_t> mapDataBuffer;
+  MapState mapState; // no tiles until the map arrived
+  std::atomic<int> playerId;
+  std::atomic<uint32_t> sessionToken; // 0 until Welcome, inputs then carry it
   std::atomic<bool> stopFlag;
 
   void initConnections(const std::string& serverIP);
   void receiveGameData();
-  void saveData(const uint8_t* data, size_t size);
+  void receiveDatagrams();
+  void saveData(const uint8_t* data);
+  bool saveMapData(const MapData* mapData);
+  bool saveGameData(const GameData* gameData);
+  bool saveGameDelta(const GameDelta* gameDelta);
+  const GameState* findGameState(uint32_t tick) const;
+  void sendPacket(flatbuffers::FlatBufferBuilder& builder) const;
+  void sendHello() const;
+  void sendAck(uint32_t tick) const;
+  void sendBind() const;
   void startLocalServer();
   void stopLocalServer();
   void waitForServer(const std::string& serverIP);
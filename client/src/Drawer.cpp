@@ -176,13 +176,13 @@ void Drawer::drawMenu() {
                    this->singlePlayerButton.label.c_str());
 }
 
-void Drawer::drawUI(const GameData* gameData, int playerId) {
+void Drawer::drawUI(const GameState* gameState, int playerId) {
   this->drawText(this->window, 910, 10, 20, "SCORES");
 
   int height = 40;
-  for (auto it = gameData->snakes()->begin(); it != gameData->snakes()->end(); ++it) {
-    std::string playerName = it->id() == playerId ? "ME" : std::to_string(it->id());
-    std::string displayText = playerName + ": " + std::to_string(it->score());
+  for (auto it = gameState->snakes.begin(); it != gameState->snakes.end(); ++it) {
+    std::string playerName = it->id == playerId ? "ME" : std::to_string(it->id);
+    std::string displayText = playerName + ": " + std::to_string(it->score);
     this->drawText(this->window, 910, height, 20, displayText.c_str());
 
     height += 25;
@@ -204,25 +204,25 @@ void Drawer::drawGame() {
     std::lock_guard<std::mutex> lock(gameDataMutex);
     std::lock_guard<std::mutex> lock2(mapDataMutex);
 
-    const GameData* gameData = client->getGameData();
-    if (!gameData)
+    const GameState* gameState = client->getGameState();
+    if (!gameState)
       return;
 
-    const MapData* mapData = client->getMapData();
-    if (!mapData)
+    const MapState* mapState = client->getMapState();
+    if (!mapState)
       return;
   
 	animationManager->onFrame();
 	  
-	int playerId = mapData->player_id();
+	int playerId = client->getPlayerId();
     
-	drawMap(mapData);
-    drawFood(gameData);
-    drawSnakes(gameData);
-    drawUI(gameData, playerId);
+	drawMap(mapState);
+    drawFood(gameState);
+    drawSnakes(gameState);
+    drawUI(gameState, playerId);
 
-    for (auto it = gameData->snakes()->begin(); it != gameData->snakes()->end(); ++it) {
-      if (it->id() == playerId) {
+    for (auto it = gameState->snakes.begin(); it != gameState->snakes.end(); ++it) {
+      if (it->id == playerId) {
         isPlayerAlive = true;
         break;
       }
@@ -233,29 +233,29 @@ void Drawer::drawGame() {
     stopClient();
 }
 
-void Drawer::drawSnakes(const GameData* gameData) {
+void Drawer::drawSnakes(const GameState* gameState) {
   int rotation = 0;
-  auto snakes = gameData->snakes();
+  auto& snakes = gameState->snakes;
 
-  for (auto snake = snakes->begin(); snake != snakes->end(); ++snake) {
-    auto body = snake->body();
-    for (auto part = body->begin(); part != body->end(); ++part) {
+  for (auto snake = snakes.begin(); snake != snakes.end(); ++snake) {
+    auto& body = snake->body;
+    for (auto part = body.begin(); part != body.end(); ++part) {
       auto nextPart = part + 1;
-      if (nextPart != body->end())
-        rotation = getRotation(part->x(), part->y(), nextPart->x(), nextPart->y());
+      if (nextPart != body.end())
+        rotation = getRotation(part->x, part->y, nextPart->x, nextPart->y);
       else
-        rotation = getRotation((part - 1)->x(), (part - 1)->y(), part->x(), part->y());
+        rotation = getRotation((part - 1)->x, (part - 1)->y, part->x, part->y);
 
       std::string texture = "assets/body.png";
-      if (part == body->begin())
+      if (part == body.begin())
         texture = "assets/head.png";
-      else if (nextPart == body->end()) {
+      else if (nextPart == body.end()) {
 		auto anim = animationManager->getAnimationSprite("tail");
 		if (anim)
 			texture = *anim;
 	  }
       else {
-        int cr = cornerPartRotation((part - 1)->x(), (part - 1)->y(), nextPart->x(), nextPart->y());
+        int cr = cornerPartRotation((part - 1)->x, (part - 1)->y, nextPart->x, nextPart->y);
         if (cr) {
           texture = "assets/body_corner.png";
 
@@ -267,46 +267,43 @@ void Drawer::drawSnakes(const GameData* gameData) {
       }
 
       // pixel on the screen to draw + offset(walls)
-      int px = part->x() * tileSize + tileSize;
-      int py = part->y() * tileSize + tileSize;
+      int px = part->x * tileSize + tileSize;
+      int py = part->y * tileSize + tileSize;
       this->drawAsset(this->window, px, py, tileSize, tileSize, rotation, texture.c_str());
     }
   }
 }
 
-void Drawer::drawFood(const GameData* gameData) {
-  auto food = gameData->food();
+void Drawer::drawFood(const GameState* gameState) {
+  auto& food = gameState->food;
 
-  for (auto it = food->begin(); it != food->end(); ++it) {
-    int px = it->x() * tileSize + tileSize;
-    int py = it->y() * tileSize + tileSize;
+  for (auto it = food.begin(); it != food.end(); ++it) {
+    int px = it->x * tileSize + tileSize;
+    int py = it->y * tileSize + tileSize;
     this->drawAsset(this->window, px, py, tileSize, tileSize, 0, "assets/food.png");
   }
 }
 
-void Drawer::drawMap(const MapData* mapData) {
-  auto map = mapData->map();
-  int y = 0;
-  for (auto row = map->begin(); row != map->end(); ++row, ++y) {
-    int x = 0;
-    for (auto tile = row->row()->begin(); tile != row->row()->end(); ++tile, ++x) {
+void Drawer::drawMap(const MapState* mapState) {
+  for (int y = 0; y < mapState->height; ++y) {
+    for (int x = 0; x < mapState->width; ++x) {
       int px = x * tileSize + tileSize;
       int py = y * tileSize + tileSize;
 
       if (x == 0)
         this->drawAsset(this->window, px - tileSize, py, tileSize, tileSize, 180, "assets/border.png");
-      else if (x == (int)map->Get(y)->row()->size() - 1)
+      else if (x == mapState->width - 1)
         this->drawAsset(this->window, px + tileSize, py, tileSize, tileSize, 0, "assets/border.png");
 
       if (y == 0)
         this->drawAsset(this->window, px, py - tileSize, tileSize, tileSize, 270, "assets/border.png");
-      else if (y == (int)map->size() - 1)
+      else if (y == mapState->height - 1)
         this->drawAsset(this->window, px, py + tileSize, tileSize, tileSize, 90, "assets/border.png");
 
-      switch (*tile) {
+      switch (mapState->tiles[y * mapState->width + x]) {
       case Tile_WallHorizontal:
       case Tile_WallVertical: {
-        auto wall = getWallTexture(x, y, mapData);
+        auto wall = getWallTexture(x, y, mapState);
         this->drawAsset(this->window, px, py, tileSize, tileSize, wall.second, wall.first.c_str());
         break;
       }
@@ -347,14 +344,12 @@ int Drawer::cornerPartRotation(int x, int y, int x2, int y2) const {
   return 0;
 }
 
-std::pair<std::string, int> Drawer::getWallTexture(int x, int y, const MapData* mapData) {
-  auto map = mapData->map();
-
+std::pair<std::string, int> Drawer::getWallTexture(int x, int y, const MapState* mapState) {
   auto isWall = [&](int cx, int cy) {
-    if (cx < 0 || cy < 0 || cx >= (int)map->Get(cy)->row()->size() || cy >= (int)map->size())
+    if (cx < 0 || cy < 0 || cx >= mapState->width || cy >= mapState->height)
       return false;
 
-    auto tile = map->Get(cy)->row()->Get(cx);
+    Tile tile = mapState->tiles[cy * mapState->width + cx];
     return tile == Tile_WallHorizontal || tile == Tile_WallVertical;
   };
 
@@ -383,8 +378,8 @@ std::pair<std::string, int> Drawer::getWallTexture(int x, int y, const MapData*
   if (up && right && !down && !left)
     return std::make_pair("assets/corner.png", 270);
 
-  return map->Get(y)->row()->Get(x) == Tile_WallHorizontal ? std::make_pair("assets/wall.png", 90)
-                                                           : std::make_pair("assets/wall.png", 0);
+  Tile tile = mapState->tiles[y * mapState->width + x];
+  return tile == Tile_WallHorizontal ? std::make_pair("assets/wall.png", 90) : std::make_pair("assets/wall.png", 0);
 }
 
 
@@ -62,13 +62,13 @@ private:
   void readAssets();
   void drawGame();
   void drawMenu();
-  void drawUI(const GameData* gameData, int playerId);
-  void drawSnakes(const GameData* gameData);
-  void drawFood(const GameData* gameData);
-  void drawMap(const MapData* mapData);
+  void drawUI(const GameState* gameState, int playerId);
+  void drawSnakes(const GameState* gameState);
+  void drawFood(const GameState* gameState);
+  void drawMap(const MapState* mapState);
   int getRotation(int x, int y, int x2, int y2) const;
   int cornerPartRotation(int x, int y, int x2, int y2) const;
-  std::pair<std::string, int> getWallTexture(int x, int y, const MapData* mapData);
+  std::pair<std::string, int> getWallTexture(int x, int y, const MapState* mapState);
 
   // EventManager callbacks
   void MoveUp(t_event* details);
@@ -0,0 +1,165 @@
+#include "Benchmark.hpp"
+#include "HeapCounter.hpp"
+#include <algorithm>
+
+#define MIN_TIME_NS 1e8 // a run shorter than this is repeated with more iterations
+#define MAX_ITERATIONS 1000000000
+#define MAX_GROWTH 10
+
+using Clock = std::chrono::steady_clock;
+
+BenchState::BenchState(const std::vector<int64_t>& args, size_t iterations)
+    : args(args), iterations(iterations), remaining(iterations), isStarted(false), isTiming(false),
+      allocationsAtResume(0), bytesAtResume(0), elapsedNs(0), allocations(0), allocatedBytes(0) {}
+
+BenchState::~BenchState() {}
+
+bool BenchState::keepRunning() {
+  if (!this->isStarted) {
+    this->isStarted = true;
+    resumeTiming();
+  }
+
+  if (this->remaining) {
+    this->remaining--;
+    return true;
+  }
+
+  pauseTiming();
+  return false;
+}
+
+void BenchState::pauseTiming() {
+  if (!this->isTiming)
+    return;
+
+  std::chrono::duration<double, std::nano> elapsed = Clock::now() - this->resumedAt;
+  this->elapsedNs += elapsed.count();
+  this->allocations += getHeapAllocations() - this->allocationsAtResume;
+  this->allocatedBytes += getHeapBytes() - this->bytesAtResume;
+  this->isTiming = false;
+}
+
+void BenchState::resumeTiming() {
+  if (this->isTiming)
+    return;
+
+  this->isTiming = true;
+  this->allocationsAtResume = getHeapAllocations();
+  this->bytesAtResume = getHeapBytes();
+  this->resumedAt = Clock::now();
+}
+
+void BenchState::addCounter(const std::string& name, double total) {
+  this->counters.emplace_back(name, total);
+}
+
+int64_t BenchState::range(size_t index) const { return this->args[index]; }
+
+size_t BenchState::getIterations() const { return this->iterations; }
+
+double BenchState::getElapsedNs() const { return this->elapsedNs; }
+
+uint64_t BenchState::getAllocations() const { return this->allocations; }
+
+uint64_t BenchState::getAllocatedBytes() const { return this->allocatedBytes; }
+
+const std::vector<std::pair<std::string, double>>& BenchState::getCounters() const { return this->counters; }
+
+Benchmark::Benchmark(const std::string& name, t_bench_function function) : name(name), function(function) {}
+
+Benchmark::~Benchmark() {}
+
+Benchmark* Benchmark::argNames(const std::vector<std::string>& names) {
+  this->names = names;
+  return this;
+}
+
+Benchmark* Benchmark::args(const std::vector<int64_t>& values) {
+  this->argSets.push_back(values);
+  return this;
+}
+
+Benchmark* Benchmark::apply(void (*sweep)(Benchmark* benchmark)) {
+  sweep(this);
+  return this;
+}
+
+// name/map:32/snakes:10, a bare value when the argument has no name
+std::string Benchmark::getRunName(const std::vector<int64_t>& values) const {
+  std::string runName = this->name;
+  for (size_t i = 0; i < values.size(); i++) {
+    runName += '/';
+    if (i < this->names.size())
+      runName += this->names[i] + ':';
+    runName += std::to_string(values[i]);
+  }
+  return runName;
+}
+
+void Benchmark::run(const std::string& filter) const {
+  std::vector<std::vector<int64_t>> runs = this->argSets;
+  if (runs.empty())
+    runs.emplace_back();
+
+  for (const auto& values : runs) {
+    std::string runName = getRunName(values);
+    if (runName.find(filter) != std::string::npos)
+      runOnce(runName, values);
+  }
+}
+
+// Grows the iteration count like Google Benchmark until a run lasts MIN_TIME_NS, only the last
+// run is reported
+void Benchmark::runOnce(const std::string& runName, const std::vector<int64_t>& values) const {
+  size_t iterations = 1;
+
+  while (true) {
+    BenchState state(values, iterations);
+    this->function(state);
+
+    double elapsedNs = state.getElapsedNs();
+    if (elapsedNs >= MIN_TIME_NS || iterations >= MAX_ITERATIONS) {
+      printf("{\"name\":\"%s\",\"iterations\":%zu,\"ns_per_op\":%.1f,\"bytes_per_op\":%.1f,"
+             "\"allocs_per_op\":%.2f",
+             runName.c_str(), iterations, elapsedNs / iterations,
+             (double)state.getAllocatedBytes() / iterations, (double)state.getAllocations() / iterations);
+      for (const auto& counter : state.getCounters())
+        printf(",\"%s\":%.1f", counter.first.c_str(), counter.second / iterations);
+      printf("}\n");
+      fflush(stdout);
+      return;
+    }
+
+    double growth = elapsedNs > 0 ? MIN_TIME_NS * 1.4 / elapsedNs : MAX_GROWTH;
+    growth = std::min(growth, (double)MAX_GROWTH);
+    iterations = std::max(iterations + 1, (size_t)(iterations * growth));
+    iterations = std::min(iterations, (size_t)MAX_ITERATIONS);
+  }
+}
+
+static std::vector<Benchmark*>& getBenchmarks() {
+  static std::vector<Benchmark*> benchmarks;
+  return benchmarks;
+}
+
+Benchmark* registerBenchmark(const std::string& name, t_bench_function function) {
+  getBenchmarks().push_back(new Benchmark(name, function));
+  return getBenchmarks().back();
+}
+
+int runBenchmarks(int argc, char** argv) {
+  std::string filter = argc > 1 ? argv[1] : "";
+
+  // the game logs to std::cout, the results go straight to stdout so the output stays parseable
+  std::streambuf* gameLog = std::cout.rdbuf(nullptr);
+
+  for (Benchmark* benchmark : getBenchmarks())
+    benchmark->run(filter);
+
+  std::cout.rdbuf(gameLog);
+  std::cout.clear();
+  for (Benchmark* benchmark : getBenchmarks())
+    delete benchmark;
+  return 0;
+}
@@ -0,0 +1,80 @@
+#ifndef BENCHMARK_HPP
+#define BENCHMARK_HPP
+
+#include "../includes/nibbler.hpp"
+#include <chrono>
+
+// Times the loop body of a benchmark function over a given number of iterations. Heap
+// allocations are only counted while the timer runs.
+class BenchState {
+public:
+  BenchState(const std::vector<int64_t>& args, size_t iterations);
+  BenchState(const BenchState& obj) = delete;
+  BenchState& operator=(const BenchState& obj) = delete;
+  BenchState(BenchState&& obj) = delete;
+  BenchState& operator=(BenchState&& obj) = delete;
+  ~BenchState();
+
+  bool keepRunning(); // starts the timer on the first call, stops it after the last iteration
+  void pauseTiming();
+  void resumeTiming();
+  void addCounter(const std::string& name, double total); // reported per iteration
+
+  int64_t range(size_t index) const;
+  size_t getIterations() const;
+  double getElapsedNs() const;
+  uint64_t getAllocations() const;
+  uint64_t getAllocatedBytes() const;
+  const std::vector<std::pair<std::string, double>>& getCounters() const;
+
+private:
+  std::vector<int64_t> args;
+  size_t iterations;
+  size_t remaining;
+  bool isStarted;
+  bool isTiming;
+  std::chrono::steady_clock::time_point resumedAt;
+  uint64_t allocationsAtResume;
+  uint64_t bytesAtResume;
+  double elapsedNs;
+  uint64_t allocations;
+  uint64_t allocatedBytes;
+  std::vector<std::pair<std::string, double>> counters;
+};
+
+typedef void (*t_bench_function)(BenchState& state);
+
+// One registered function and the argument sets it runs with, after Google Benchmark's API
+class Benchmark {
+public:
+  Benchmark(const std::string& name, t_bench_function function);
+  Benchmark(const Benchmark& obj) = delete;
+  Benchmark& operator=(const Benchmark& obj) = delete;
+  Benchmark(Benchmark&& obj) = delete;
+  Benchmark& operator=(Benchmark&& obj) = delete;
+  ~Benchmark();
+
+  Benchmark* argNames(const std::vector<std::string>& names);
+  Benchmark* args(const std::vector<int64_t>& values);
+  Benchmark* apply(void (*sweep)(Benchmark* benchmark));
+
+  void run(const std::string& filter) const;
+
+private:
+  std::string name;
+  t_bench_function function;
+  std::vector<std::string> names;
+  std::vector<std::vector<int64_t>> argSets;
+
+  std::string getRunName(const std::vector<int64_t>& values) const;
+  void runOnce(const std::string& runName, const std::vector<int64_t>& values) const;
+};
+
+Benchmark* registerBenchmark(const std::string& name, t_bench_function function);
+
+// Runs every benchmark whose name contains argv[1], one JSON object per line on stdout
+int runBenchmarks(int argc, char** argv);
+
+#define BENCHMARK(function) static Benchmark* function##Benchmark = registerBenchmark(#function, function)
+
+#endif
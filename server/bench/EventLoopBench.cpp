@@ -0,0 +1,111 @@
+#include "../src/EventLoop.hpp"
+#include <chrono>
+#include <sys/resource.h>
+
+#define WAKEUPS_PER_RUN 20000
+
+using Clock = std::chrono::steady_clock;
+
+// Each wakeup makes exactly one of N idle sessions readable, then measures how long the loop
+// needs to wake up, find that session and drain it. The poll variant is the loop Server::start
+// used before the epoll reactor: poll() over every fd followed by a linear revents scan.
+
+static double benchPoll(const std::vector<int>& readers, const std::vector<int>& writers,
+                        const std::vector<int>& targets) {
+  std::vector<struct pollfd> fds;
+  for (int fd : readers)
+    fds.push_back({fd, POLLIN, 0});
+
+  char byte = 0;
+  auto begin = Clock::now();
+
+  for (int target : targets) {
+    write(writers[target], &byte, 1);
+    poll(fds.data(), fds.size(), -1);
+
+    for (const auto& fd : fds) {
+      if (fd.revents & POLLIN)
+        read(fd.fd, &byte, 1);
+    }
+  }
+
+  std::chrono::duration<double, std::nano> elapsed = Clock::now() - begin;
+  return elapsed.count() / targets.size();
+}
+
+static double benchEventLoop(const std::vector<int>& readers, const std::vector<int>& writers,
+                             const std::vector<int>& targets) {
+  EventLoop loop;
+  for (int fd : readers)
+    loop.add(fd, EVENT_READ);
+
+  char byte = 0;
+  auto begin = Clock::now();
+
+  for (int target : targets) {
+    write(writers[target], &byte, 1);
+    int count = loop.wait(-1);
+
+    for (int i = 0; i < count; i++) {
+      if (loop.getEvent(i).events & EVENT_READ)
+        read(loop.getEvent(i).fd, &byte, 1);
+    }
+  }
+
+  std::chrono::duration<double, std::nano> elapsed = Clock::now() - begin;
+  return elapsed.count() / targets.size();
+}
+
+static size_t maxSessions() {
+  struct rlimit limit;
+  if (getrlimit(RLIMIT_NOFILE, &limit) != 0)
+    return 0;
+
+  limit.rlim_cur = limit.rlim_max;
+  setrlimit(RLIMIT_NOFILE, &limit);
+  getrlimit(RLIMIT_NOFILE, &limit);
+
+  // two fds per session plus some headroom for the process itself
+  return limit.rlim_cur > 64 ? (limit.rlim_cur - 64) / 2 : 0;
+}
+
+int main() {
+  const size_t sessionCounts[] = {16, 64, 256, 1024, 4096, 8192};
+  const size_t limit = maxSessions();
+
+  srand(42);
+  printf("%10s %18s %18s\n", "sessions", "poll ns/wakeup", "reactor ns/wakeup");
+
+  for (size_t sessions : sessionCounts) {
+    if (sessions > limit) {
+      printf("%10zu %18s %18s\n", sessions, "fd limit", "fd limit");
+      continue;
+    }
+
+    std::vector<int> readers;
+    std::vector<int> writers;
+    for (size_t i = 0; i < sessions; i++) {
+      int pair[2];
+      if (socketpair(AF_UNIX, SOCK_STREAM, 0, pair) == -1) {
+        perror("socketpair");
+        return EXIT_FAILURE;
+      }
+      fcntl(pair[0], F_SETFL, O_NONBLOCK);
+      readers.push_back(pair[0]);
+      writers.push_back(pair[1]);
+    }
+
+    std::vector<int> targets(WAKEUPS_PER_RUN);
+    for (int& target : targets)
+      target = rand() % sessions;
+
+    double pollNs = benchPoll(readers, writers, targets);
+    double reactorNs = benchEventLoop(readers, writers, targets);
+    printf("%10zu %18.0f %18.0f\n", sessions, pollNs, reactorNs);
+
+    for (size_t i = 0; i < sessions; i++) {
+      close(readers[i]);
+      close(writers[i]);
+    }
+  }
+}
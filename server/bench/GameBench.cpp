@@ -0,0 +1,211 @@
+#include "../src/Field.hpp"
+#include "../src/FrameBuilder.hpp"
+#include "../src/Game.hpp"
+#include "../src/MapRegistry.hpp"
+#include "../src/Snapshot.hpp"
+#include "Benchmark.hpp"
+#include <random>
+
+#define BENCH_SEED 42
+#define TURN_ODDS 4              // a snake turns on one tick out of four
+#define SETTLE_TICKS 8           // played before the snapshots are taken
+#define MAX_OCCUPANCY_PERCENT 25 // the sweep skips rooms whose snakes would cover more of the map
+
+static const int64_t mapSizes[] = {32, 64, 100, 256};
+static const int64_t snakeCounts[] = {1, 10, 100, 1000};
+static const int64_t snakeLengths[] = {4, 16, 64};
+static const int64_t crowdedPercents[] = {95, 99}; // random picks mostly miss, then Field ranks its cell
+
+static std::shared_ptr<const t_map> makeMap(int size) {
+  auto map = std::make_shared<t_map>();
+  map->walls.reset(size, size, FLOOR_TILE);
+  MapRegistry::build(*map);
+  return map;
+}
+
+// Players as the network thread would feed them: a few turns per tick, and the dead joining
+// again straight away so the room keeps its size
+static void steer(Game& game, std::mt19937& random, int snakeCount, int length) {
+  std::shared_ptr<const t_snapshot> snapshot = game.getPublishedSnapshot();
+  size_t next = 0;
+
+  for (int id = 1; id <= snakeCount; id++) {
+    bool isAlive = false;
+    if (snapshot) {
+      while (next < snapshot->snakes.size() && snapshot->snakes[next].id < id)
+        next++;
+      isAlive = next < snapshot->snakes.size() && snapshot->snakes[next].id == id;
+    }
+
+    if (!isAlive) {
+      if (snapshot)
+        game.removeSnake(id);
+      game.addSnake(id, length);
+      game.updateSnakeDirection(id, random() % 4);
+    } else if (random() % TURN_ODDS == 0) {
+      game.updateSnakeDirection(id, random() % 4);
+    }
+  }
+}
+
+static void playTick(Game& game) {
+  game.proposeMoves(0, game.beginTick());
+  game.endTick();
+}
+
+// The two latest snapshots of a room that played SETTLE_TICKS
+static void settle(Game& game, int snakeCount, int length, std::shared_ptr<const t_snapshot>& previous,
+                   std::shared_ptr<const t_snapshot>& current) {
+  std::mt19937 random(BENCH_SEED);
+  for (int tick = 0; tick < SETTLE_TICKS; tick++) {
+    steer(game, random, snakeCount, length);
+    playTick(game);
+  }
+
+  previous = game.getPublishedSnapshot();
+  steer(game, random, snakeCount, length);
+  playTick(game);
+  current = game.getPublishedSnapshot();
+}
+
+// The rooms the sweep covers: every map size, snake count and length that fits
+static void sweepRooms(Benchmark* benchmark) {
+  for (int64_t size : mapSizes) {
+    for (int64_t snakes : snakeCounts) {
+      for (int64_t length : snakeLengths) {
+        if (snakes * length * 100 <= size * size * MAX_OCCUPANCY_PERCENT)
+          benchmark->args({size, snakes, length});
+      }
+    }
+  }
+}
+
+// As many snakes as cover each of crowdedPercents of the map
+static void sweepCrowdedRooms(Benchmark* benchmark) {
+  for (int64_t size : mapSizes) {
+    for (int64_t percent : crowdedPercents) {
+      for (int64_t length : snakeLengths)
+        benchmark->args({size, size * size * percent / 100 / length, length});
+    }
+  }
+}
+
+static void sweepMaps(Benchmark* benchmark) {
+  for (int64_t size : mapSizes)
+    benchmark->args({size});
+}
+
+// A whole room step: commands, moves, food and the published snapshot. The steering between
+// ticks is not timed.
+static void BM_tick(BenchState& state) {
+  Game game(makeMap(state.range(0)), BENCH_SEED);
+  std::mt19937 random(BENCH_SEED);
+  double moved = 0;
+
+  while (state.keepRunning()) {
+    state.pauseTiming();
+    steer(game, random, state.range(1), state.range(2));
+    state.resumeTiming();
+
+    size_t count = game.beginTick();
+    game.proposeMoves(0, count);
+    game.endTick();
+    moved += count;
+  }
+
+  state.addCounter("snakes_moved", moved);
+}
+BENCHMARK(BM_tick)->argNames({"map", "snakes", "length"})->apply(sweepRooms);
+
+// What Game::spawnFood costs on a field the snakes cover: a free cell is drawn and painted, then
+// cleared again so every iteration sees the same field
+static void BM_spawnFood(BenchState& state) {
+  std::shared_ptr<const t_map> map = makeMap(state.range(0));
+  Field field(std::shared_ptr<const Grid>(map, &map->walls));
+
+  std::mt19937 random(BENCH_SEED);
+  int64_t covered = state.range(1) * state.range(2);
+  for (int64_t cell = 0; cell < covered;) {
+    int x = random() % field.getWidth();
+    int y = random() % field.getHeight();
+    if (field.isFree(x, y)) {
+      field.setTile(x, y, BODY_TILE, cell / state.range(2));
+      cell++;
+    }
+  }
+
+  while (state.keepRunning()) {
+    int x;
+    int y;
+    if (field.pickFreeCell(x, y, random)) {
+      field.setTile(x, y, FOOD_TILE);
+      field.setTile(x, y, FLOOR_TILE);
+    }
+  }
+}
+BENCHMARK(BM_spawnFood)->argNames({"map", "snakes", "length"})->apply(sweepRooms)->apply(sweepCrowdedRooms);
+
+// Both encodings of a full state, as Game::publishSnapshot builds them every tick
+static void BM_serializeSnapshot(BenchState& state) {
+  Game game(makeMap(state.range(0)), BENCH_SEED);
+  std::shared_ptr<const t_snapshot> previous;
+  std::shared_ptr<const t_snapshot> current;
+  settle(game, state.range(1), state.range(2), previous, current);
+
+  FrameBuilder frameBuilder;
+  t_serialize_scratch scratch;
+  double frameBytes = 0;
+
+  while (state.keepRunning()) {
+    frameBuilder.rewind();
+    for (size_t encoding = 0; encoding < SNAPSHOT_ENCODINGS; encoding++) {
+      flatbuffers::FlatBufferBuilder& builder = frameBuilder.start();
+      builder.Finish(serializeSnapshot(builder, scratch, *current, encoding));
+      frameBytes += frameBuilder.finish()->size();
+    }
+  }
+
+  state.addCounter("frame_bytes", frameBytes);
+}
+BENCHMARK(BM_serializeSnapshot)->argNames({"map", "snakes", "length"})->apply(sweepRooms);
+
+// Both encodings of the delta against the previous tick, the base most clients ack
+static void BM_serializeDelta(BenchState& state) {
+  Game game(makeMap(state.range(0)), BENCH_SEED);
+  std::shared_ptr<const t_snapshot> previous;
+  std::shared_ptr<const t_snapshot> current;
+  settle(game, state.range(1), state.range(2), previous, current);
+
+  FrameBuilder frameBuilder;
+  t_serialize_scratch scratch;
+  double frameBytes = 0;
+
+  while (state.keepRunning()) {
+    frameBuilder.rewind();
+    for (size_t encoding = 0; encoding < SNAPSHOT_ENCODINGS; encoding++) {
+      flatbuffers::FlatBufferBuilder& builder = frameBuilder.start();
+      builder.Finish(serializeDelta(builder, scratch, *previous, *current, encoding));
+      frameBytes += frameBuilder.finish()->size();
+    }
+  }
+
+  state.addCounter("frame_bytes", frameBytes);
+}
+BENCHMARK(BM_serializeDelta)->argNames({"map", "snakes", "length"})->apply(sweepRooms);
+
+// Kernel tiles and both MapData frames, once per map the registry loads
+static void BM_serializeMap(BenchState& state) {
+  t_map map;
+  map.walls.reset(state.range(0), state.range(0), FLOOR_TILE);
+  double frameBytes = 0;
+
+  while (state.keepRunning()) {
+    MapRegistry::build(map);
+    frameBytes += map.frame->size() + map.packedFrame->size();
+  }
+
+  state.addCounter("frame_bytes", frameBytes);
+}
+BENCHMARK(BM_serializeMap)->argNames({"map"})->apply(sweepMaps);
+
+int main(int argc, char** argv) { return runBenchmarks(argc, argv); }
@@ -0,0 +1,121 @@
+#include "../src/HeadKernel.hpp"
+#include <chrono>
+
+#define FIELD_WIDTH 512
+#define FIELD_HEIGHT 512
+#define WALL_PERCENT 10
+#define HEADS_PER_RUN (4 * 1024 * 1024)
+
+using Clock = std::chrono::steady_clock;
+
+typedef struct s_heads {
+  std::vector<int> headX;
+  std::vector<int> headY;
+  std::vector<int> directions;
+  std::vector<int> nextX;
+  std::vector<int> nextY;
+  std::vector<uint8_t> isBlocked;
+} t_heads;
+
+// Random walls, and heads anywhere on the field so a share of them runs off the edge
+static std::vector<char> makeTiles() {
+  std::vector<char> tiles((size_t)FIELD_WIDTH * FIELD_HEIGHT + HEAD_KERNEL_PADDING, FLOOR_TILE);
+  for (size_t i = 0; i < (size_t)FIELD_WIDTH * FIELD_HEIGHT; i++) {
+    if (rand() % 100 < WALL_PERCENT)
+      tiles[i] = rand() % 2 ? WALL_HORIZ_TILE : WALL_VERTI_TILE;
+  }
+  return tiles;
+}
+
+static void makeHeads(t_heads& heads, size_t count) {
+  heads.headX.resize(count);
+  heads.headY.resize(count);
+  heads.directions.resize(count);
+  heads.nextX.assign(count, 0);
+  heads.nextY.assign(count, 0);
+  heads.isBlocked.assign(count, 0);
+
+  for (size_t i = 0; i < count; i++) {
+    heads.headX[i] = rand() % FIELD_WIDTH;
+    heads.headY[i] = rand() % FIELD_HEIGHT;
+    heads.directions[i] = rand() % 4;
+  }
+}
+
+static t_head_batch makeBatch(t_heads& heads, const std::vector<char>& tiles) {
+  t_head_batch batch;
+  batch.headX = heads.headX.data();
+  batch.headY = heads.headY.data();
+  batch.directions = heads.directions.data();
+  batch.nextX = heads.nextX.data();
+  batch.nextY = heads.nextY.data();
+  batch.isBlocked = heads.isBlocked.data();
+  batch.count = heads.headX.size();
+  batch.tiles = tiles.data();
+  batch.width = FIELD_WIDTH;
+  batch.height = FIELD_HEIGHT;
+  return batch;
+}
+
+// ns per tick of count snakes, one tick being a single kernel call
+static double benchKernel(t_head_kernel kernel, const t_head_batch& batch) {
+  size_t ticks = HEADS_PER_RUN / batch.count;
+
+  kernel(batch); // warm up
+  auto begin = Clock::now();
+  for (size_t tick = 0; tick < ticks; tick++)
+    kernel(batch);
+
+  std::chrono::duration<double, std::nano> elapsed = Clock::now() - begin;
+  return elapsed.count() / ticks;
+}
+
+static bool isSameOutput(const t_heads& expected, const t_heads& actual) {
+  return expected.nextX == actual.nextX && expected.nextY == actual.nextY &&
+         expected.isBlocked == actual.isBlocked;
+}
+
+// Game::proposeMoves cost per tick, every kernel the CPU supports against the scalar loop. The
+// outputs are compared first, a kernel that disagrees with the scalar one fails the run.
+int main() {
+  const size_t snakeCounts[] = {10, 100, 1000, 10000, 100000};
+  std::vector<char> tiles = makeTiles();
+
+  printf("%8s", "snakes");
+  for (int kind = 0; kind < HEAD_KERNEL_COUNT; kind++)
+    printf(" %14s ns/tick", getHeadKernelName((enum e_head_kernel)kind));
+  printf("\n");
+
+  for (size_t count : snakeCounts) {
+    t_heads expected;
+    makeHeads(expected, count);
+    getHeadKernel(HEAD_KERNEL_SCALAR)(makeBatch(expected, tiles));
+
+    printf("%8zu", count);
+    for (int kind = 0; kind < HEAD_KERNEL_COUNT; kind++) {
+      t_head_kernel kernel = getHeadKernel((enum e_head_kernel)kind);
+      if (!kernel) {
+        printf(" %22s", "n/a");
+        continue;
+      }
+
+      t_heads heads;
+      heads.headX = expected.headX;
+      heads.headY = expected.headY;
+      heads.directions = expected.directions;
+      heads.nextX.assign(count, 0);
+      heads.nextY.assign(count, 0);
+      heads.isBlocked.assign(count, 0);
+      t_head_batch batch = makeBatch(heads, tiles);
+
+      kernel(batch);
+      if (!isSameOutput(expected, heads)) {
+        printf("\n%s disagrees with the scalar kernel\n", getHeadKernelName((enum e_head_kernel)kind));
+        return 1;
+      }
+
+      printf(" %22.0f", benchKernel(kernel, batch));
+    }
+    printf("\n");
+  }
+}
@@ -0,0 +1,24 @@
+#include "HeapCounter.hpp"
+#include <new>
+
+// Every heap allocation in the process goes through here, new[] included. Kept out of line, GCC
+// flags a free() inlined next to a new it cannot see is ours.
+static uint64_t heapAllocations = 0;
+static uint64_t heapBytes = 0;
+
+__attribute__((noinline)) void* operator new(size_t size) {
+  heapAllocations++;
+  heapBytes += size;
+  void* p = malloc(size ? size : 1);
+  if (!p)
+    throw std::bad_alloc();
+  return p;
+}
+
+__attribute__((noinline)) void operator delete(void* p) noexcept { free(p); }
+
+__attribute__((noinline)) void operator delete(void* p, size_t) noexcept { free(p); }
+
+uint64_t getHeapAllocations() { return heapAllocations; }
+
+uint64_t getHeapBytes() { return heapBytes; }
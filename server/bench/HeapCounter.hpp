@@ -0,0 +1,11 @@
+#ifndef HEAP_COUNTER_HPP
+#define HEAP_COUNTER_HPP
+
+#include "../includes/nibbler.hpp"
+
+// Linking bench/HeapCounter.cpp replaces the global operator new, these count what went through
+// it since the start of the process
+uint64_t getHeapAllocations();
+uint64_t getHeapBytes();
+
+#endif
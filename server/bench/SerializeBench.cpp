@@ -0,0 +1,130 @@
+#include "../src/FrameBuilder.hpp"
+#include "../src/Snapshot.hpp"
+#include "HeapCounter.hpp"
+#include <chrono>
+
+#define WARMUP_TICKS (2 * SNAPSHOT_HISTORY)
+#define TICKS_PER_RUN 2000
+#define SNAKE_LENGTH 24
+#define FOOD_COUNT 3
+
+using Clock = std::chrono::steady_clock;
+
+typedef struct s_result {
+  double allocsPerTick;
+  double nsPerTick;
+} t_result;
+
+// Snake i crawls right along row i, so deltas carry one new head per snake and bodies pack
+static void fillSnapshot(t_snapshot& snapshot, uint32_t tick, size_t snakeCount) {
+  snapshot.snakes.resize(snakeCount);
+  for (size_t i = 0; i < snakeCount; i++) {
+    t_snake_state& snake = snapshot.snakes[i];
+    snake.id = i + 1;
+    snake.score = tick / 10;
+    snake.state = State_Alive;
+    snake.body.resize(SNAKE_LENGTH);
+    for (size_t k = 0; k < SNAKE_LENGTH; k++)
+      snake.body[k] = {(int)(tick + SNAKE_LENGTH - k), (int)i};
+  }
+
+  snapshot.food.resize(FOOD_COUNT);
+  for (size_t i = 0; i < FOOD_COUNT; i++)
+    snapshot.food[i] = {(int)(tick * 7 + i) % 100, (int)i};
+}
+
+// The frames Server builds in a tick where clients sit on a few different baselines: a full
+// state in both encodings and two deltas. The previous tick's frames are still queued meanwhile.
+template <typename Serialize>
+static t_result runTicks(size_t snakeCount, Serialize serialize) {
+  SnapshotHistory history;
+  std::shared_ptr<t_snapshot> snapshots[SNAPSHOT_HISTORY]; // recycled like the game's pool
+  std::vector<t_frame_buffer> queued;
+  queued.reserve(8);
+
+  size_t allocations = 0;
+  double elapsedNs = 0;
+
+  for (uint32_t tick = 1; tick <= WARMUP_TICKS + TICKS_PER_RUN; tick++) {
+    std::shared_ptr<t_snapshot>& slot = snapshots[tick % SNAPSHOT_HISTORY];
+    if (!slot)
+      slot = std::make_shared<t_snapshot>();
+    t_snapshot& snapshot = *slot;
+    snapshot.tick = tick;
+    fillSnapshot(snapshot, tick, snakeCount);
+    history.push(slot);
+
+    uint64_t allocationsBefore = getHeapAllocations();
+    auto begin = Clock::now();
+
+    queued.clear();
+    serialize(history, snapshot, queued);
+
+    std::chrono::duration<double, std::nano> elapsed = Clock::now() - begin;
+    if (tick > WARMUP_TICKS) {
+      allocations += getHeapAllocations() - allocationsBefore;
+      elapsedNs += elapsed.count();
+    }
+  }
+
+  return {(double)allocations / TICKS_PER_RUN, elapsedNs / TICKS_PER_RUN};
+}
+
+// What the server did before: a fresh builder per frame and a new buffer for every frame
+static t_result benchFresh(size_t snakeCount) {
+  return runTicks(snakeCount, [](SnapshotHistory& history, const t_snapshot& snapshot,
+                                 std::vector<t_frame_buffer>& queued) {
+    const t_snapshot* bases[] = {nullptr, nullptr, history.find(snapshot.tick - 1),
+                                 history.find(snapshot.tick - 4)};
+
+    for (size_t i = 0; i < 4; i++) {
+      flatbuffers::FlatBufferBuilder builder(1024);
+      t_serialize_scratch scratch;
+      if (bases[i])
+        builder.Finish(serializeDelta(builder, scratch, *bases[i], snapshot, i % 2));
+      else
+        builder.Finish(serializeSnapshot(builder, scratch, snapshot, i % 2));
+
+      uint32_t sizeNetwork = htonl(builder.GetSize());
+      const uint8_t* prefix = reinterpret_cast<const uint8_t*>(&sizeNetwork);
+      auto frame = std::make_shared<std::vector<uint8_t>>(prefix, prefix + sizeof(sizeNetwork));
+      frame->insert(frame->end(), builder.GetBufferPointer(), builder.GetBufferPointer() + builder.GetSize());
+      queued.push_back(frame);
+    }
+  });
+}
+
+static t_result benchPersistent(size_t snakeCount) {
+  FrameBuilder frameBuilder;
+  t_serialize_scratch scratch;
+
+  return runTicks(snakeCount, [&](SnapshotHistory& history, const t_snapshot& snapshot,
+                                  std::vector<t_frame_buffer>& queued) {
+    const t_snapshot* bases[] = {nullptr, nullptr, history.find(snapshot.tick - 1),
+                                 history.find(snapshot.tick - 4)};
+
+    frameBuilder.rewind();
+    for (size_t i = 0; i < 4; i++) {
+      flatbuffers::FlatBufferBuilder& builder = frameBuilder.start();
+      if (bases[i])
+        builder.Finish(serializeDelta(builder, scratch, *bases[i], snapshot, i % 2));
+      else
+        builder.Finish(serializeSnapshot(builder, scratch, snapshot, i % 2));
+      queued.push_back(frameBuilder.finish());
+    }
+  });
+}
+
+int main() {
+  const size_t snakeCounts[] = {1, 10, 100, 1000};
+
+  printf("%8s %16s %16s %16s %16s\n", "snakes", "fresh allocs", "arena allocs", "fresh ns/tick",
+         "arena ns/tick");
+
+  for (size_t snakes : snakeCounts) {
+    t_result fresh = benchFresh(snakes);
+    t_result persistent = benchPersistent(snakes);
+    printf("%8zu %16.1f %16.1f %16.0f %16.0f\n", snakes, fresh.allocsPerTick, persistent.allocsPerTick,
+           fresh.nsPerTick, persistent.nsPerTick);
+  }
+}
@@ -0,0 +1,258 @@
+#include "BotSession.hpp"
+#include <arpa/inet.h>
+#include <chrono>
+#include <errno.h>
+
+#define RECEIVE_CHUNK_SIZE 16384
+#define MAX_INBOUND_PACKET (1024 * 1024)
+#define MAX_DATAGRAM_SIZE 1500
+#define RANDOM_TURN_ODDS 4 // a random turn on one tick out of four
+#define INPUT_SIZE 6       // direction, padding, session token big-endian
+
+static int64_t nowMicros() {
+  auto now = std::chrono::steady_clock::now().time_since_epoch();
+  return std::chrono::duration_cast<std::chrono::microseconds>(now).count();
+}
+
+static uint32_t readLength(const uint8_t* data) {
+  uint32_t sizeNetwork;
+  memcpy(&sizeNetwork, data, sizeof(sizeNetwork));
+  return ntohl(sizeNetwork);
+}
+
+BotSession::BotSession(int id, const sockaddr_in& serverAddr, uint32_t features, const std::string& script)
+    : id(id), serverAddr(serverAddr), features(features), script(script), scriptIndex(0), tcpFd(-1),
+      udpFd(-1), isConnected(false), playerId(-1), token(0), lastTick(0), lastArrival(0), random(id),
+      stats() {}
+
+BotSession::~BotSession() { close(); }
+
+// Starts a non-blocking connect, the Hello goes out once the socket turns writable
+bool BotSession::open() {
+  this->tcpFd = socket(AF_INET, SOCK_STREAM, 0);
+  this->udpFd = socket(AF_INET, SOCK_DGRAM, 0);
+  if (this->tcpFd == -1 || this->udpFd == -1)
+    return false;
+
+  if (fcntl(this->tcpFd, F_SETFL, O_NONBLOCK) == -1 || fcntl(this->udpFd, F_SETFL, O_NONBLOCK) == -1)
+    return false;
+
+  int flag = 1; // Disable Nagle's Algorithm
+  setsockopt(this->tcpFd, IPPROTO_TCP, TCP_NODELAY, &flag, sizeof(flag));
+
+  // a connected UDP socket only hears from the server
+  if (connect(this->udpFd, (struct sockaddr*)&this->serverAddr, sizeof(this->serverAddr)) == -1)
+    return false;
+
+  if (connect(this->tcpFd, (struct sockaddr*)&this->serverAddr, sizeof(this->serverAddr)) == -1 &&
+      errno != EINPROGRESS)
+    return false;
+  return true;
+}
+
+void BotSession::close() {
+  if (this->tcpFd != -1)
+    ::close(this->tcpFd);
+  if (this->udpFd != -1)
+    ::close(this->udpFd);
+  this->tcpFd = -1;
+  this->udpFd = -1;
+}
+
+bool BotSession::onWritable() {
+  if (!this->isConnected) {
+    int error = 0;
+    socklen_t length = sizeof(error);
+    if (getsockopt(this->tcpFd, SOL_SOCKET, SO_ERROR, &error, &length) == -1 || error)
+      return false;
+
+    this->isConnected = true;
+    sendHello();
+  }
+  return flush();
+}
+
+// Drains the socket, returns false on close, error or a packet over MAX_INBOUND_PACKET
+bool BotSession::onReadable() {
+  while (true) {
+    size_t used = this->inbound.size();
+    this->inbound.resize(used + RECEIVE_CHUNK_SIZE);
+
+    ssize_t n = recv(this->tcpFd, this->inbound.data() + used, RECEIVE_CHUNK_SIZE, 0);
+    this->inbound.resize(used + (n > 0 ? n : 0));
+
+    if (n > 0) {
+      this->stats.tcpBytes += n;
+      continue;
+    }
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+      break;
+    return false;
+  }
+
+  size_t offset = 0;
+  while (this->inbound.size() - offset >= sizeof(uint32_t)) {
+    uint32_t size = readLength(this->inbound.data() + offset);
+    if (size > MAX_INBOUND_PACKET)
+      return false;
+    if (this->inbound.size() - offset - sizeof(uint32_t) < size)
+      break;
+
+    handlePacket(this->inbound.data() + offset + sizeof(uint32_t), size, false);
+    offset += sizeof(uint32_t) + size;
+  }
+  this->inbound.erase(this->inbound.begin(), this->inbound.begin() + offset);
+
+  return flush();
+}
+
+void BotSession::onDatagrams() {
+  uint8_t buffer[MAX_DATAGRAM_SIZE];
+
+  while (true) {
+    ssize_t n = recv(this->udpFd, buffer, sizeof(buffer), 0);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      break;
+
+    this->stats.udpBytes += n;
+    handlePacket(buffer, n, true);
+  }
+  flush();
+}
+
+void BotSession::handlePacket(const uint8_t* data, uint32_t size, bool isDatagram) {
+  flatbuffers::Verifier verifier(data, size);
+  if (!VerifyPacketBuffer(verifier))
+    return;
+
+  const Packet* packet = GetPacket(data);
+  if (const GameData* gameData = packet->data_as_GameData())
+    return onSnapshot(gameData->tick(), size, isDatagram);
+  if (const GameDelta* gameDelta = packet->data_as_GameDelta())
+    return onSnapshot(gameDelta->tick(), size, isDatagram);
+
+  if (const Welcome* welcome = packet->data_as_Welcome()) {
+    this->playerId = welcome->player_id();
+    this->token = welcome->token();
+    if (this->features & Feature_UdpSnapshots)
+      sendBind();
+  }
+}
+
+// Every new tick is acked over TCP, the server picks its delta base and keeps UDP from it
+void BotSession::onSnapshot(uint32_t tick, uint32_t size, bool isDatagram) {
+  if (tick <= this->lastTick) {
+    this->stats.stale++;
+    return;
+  }
+
+  int64_t now = nowMicros();
+  if (this->lastArrival)
+    this->stats.intervals.push_back(now - this->lastArrival);
+  if (this->lastTick && tick > this->lastTick + 1) {
+    this->stats.missedTicks += tick - this->lastTick - 1;
+    this->stats.gaps++;
+  }
+  this->lastArrival = now;
+  this->lastTick = tick;
+
+  this->stats.snapshots++;
+  this->stats.udpSnapshots += isDatagram;
+  this->stats.snapshotBytes += size;
+  this->stats.maxSnapshotBytes = std::max<uint64_t>(this->stats.maxSnapshotBytes, size);
+
+  sendAck(tick);
+  // snapshots still on TCP, the bind datagram has not made it to the server yet
+  if (!isDatagram && this->token && (this->features & Feature_UdpSnapshots))
+    sendBind();
+  sendTurn();
+}
+
+// TCP, same length-prefixed framing the server uses
+void BotSession::sendPacket(flatbuffers::FlatBufferBuilder& builder) {
+  uint32_t netSize = htonl(builder.GetSize());
+  const uint8_t* prefix = reinterpret_cast<const uint8_t*>(&netSize);
+  this->outbound.insert(this->outbound.end(), prefix, prefix + sizeof(netSize));
+  this->outbound.insert(this->outbound.end(), builder.GetBufferPointer(),
+                        builder.GetBufferPointer() + builder.GetSize());
+}
+
+// Writes what the socket takes, the rest waits for the next writable event
+bool BotSession::flush() {
+  size_t offset = 0;
+  while (this->isConnected && offset < this->outbound.size()) {
+    ssize_t n =
+        send(this->tcpFd, this->outbound.data() + offset, this->outbound.size() - offset, MSG_NOSIGNAL);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+      break;
+    if (n < 0)
+      return false;
+    offset += n;
+  }
+  this->outbound.erase(this->outbound.begin(), this->outbound.begin() + offset);
+  return true;
+}
+
+void BotSession::sendHello() {
+  flatbuffers::FlatBufferBuilder builder(64);
+
+  auto hello = CreateHello(builder, this->features);
+  builder.Finish(CreatePacket(builder, MsgType_Hello, MsgUnion_Hello, hello.Union()));
+  sendPacket(builder);
+}
+
+void BotSession::sendAck(uint32_t tick) {
+  flatbuffers::FlatBufferBuilder builder(64);
+
+  auto ack = CreateAck(builder, tick);
+  builder.Finish(CreatePacket(builder, MsgType_Ack, MsgUnion_Ack, ack.Union()));
+  sendPacket(builder);
+}
+
+// UDP, the token alone binds this socket as the snapshot endpoint
+void BotSession::sendBind() {
+  uint32_t tokenNetwork = htonl(this->token);
+  send(this->udpFd, &tokenNetwork, sizeof(tokenNetwork), 0);
+}
+
+// One scripted step per tick, or a random direction now and then. The server ignores a reversal.
+void BotSession::sendTurn() {
+  int direction = -1;
+  if (!this->script.empty()) {
+    char step = this->script[this->scriptIndex++ % this->script.size()];
+    const char* directions = "UDLR";
+    if (const char* found = strchr(directions, step))
+      direction = found - directions;
+  } else if (this->random() % RANDOM_TURN_ODDS == 0) {
+    direction = this->random() % 4;
+  }
+
+  if (direction < 0 || !this->token)
+    return;
+
+  uint8_t input[INPUT_SIZE] = {(uint8_t)direction, 0};
+  uint32_t tokenNetwork = htonl(this->token);
+  memcpy(input + 2, &tokenNetwork, sizeof(tokenNetwork));
+  if (send(this->udpFd, input, sizeof(input), 0) == sizeof(input))
+    this->stats.turns++;
+}
+
+int BotSession::getId() const { return this->id; }
+
+int BotSession::getPlayerId() const { return this->playerId; }
+
+int BotSession::getTcpFd() const { return this->tcpFd; }
+
+int BotSession::getUdpFd() const { return this->udpFd; }
+
+bool BotSession::getIsOpen() const { return this->tcpFd != -1; }
+
+bool BotSession::hasPendingOutput() const { return !this->isConnected || !this->outbound.empty(); }
+
+const t_bot_stats& BotSession::getStats() const { return this->stats; }
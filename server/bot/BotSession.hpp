@@ -0,0 +1,74 @@
+#ifndef BOTSESSION_HPP
+#define BOTSESSION_HPP
+
+#include "../includes/nibbler.hpp"
+#include <random>
+
+typedef struct s_bot_stats {
+  uint64_t snapshots;     // new ticks, by either transport
+  uint64_t udpSnapshots;  // the share of them that came over UDP
+  uint64_t stale;         // ticks at or behind the newest one, duplicates across transports included
+  uint64_t missedTicks;   // ticks skipped between two snapshots
+  uint64_t gaps;          // times at least one tick was skipped
+  uint64_t snapshotBytes; // payload of the new ticks, without the TCP length prefix
+  uint64_t maxSnapshotBytes;
+  uint64_t tcpBytes;
+  uint64_t udpBytes;
+  uint64_t turns;
+  std::vector<int64_t> intervals; // microseconds between two new ticks
+} t_bot_stats;
+
+// One synthetic player: the TCP session of a Hello client and a UDP socket for its directions and,
+// when announced, its snapshots. Only the snapshot ticks are read, the bodies are never applied.
+class BotSession {
+public:
+  BotSession(int id, const sockaddr_in& serverAddr, uint32_t features, const std::string& script);
+  BotSession(const BotSession& obj) = delete;
+  BotSession& operator=(const BotSession& obj) = delete;
+  BotSession(BotSession&& obj) = delete;
+  BotSession& operator=(BotSession&& obj) = delete;
+  ~BotSession();
+
+  bool open();
+  void close();
+  bool onWritable();
+  bool onReadable();
+  void onDatagrams();
+
+  int getId() const;
+  int getPlayerId() const;
+  int getTcpFd() const;
+  int getUdpFd() const;
+  bool getIsOpen() const;
+  bool hasPendingOutput() const;
+  const t_bot_stats& getStats() const;
+
+private:
+  int id;
+  sockaddr_in serverAddr;
+  uint32_t features;
+  std::string script; // one turn per tick, empty for random turns
+  size_t scriptIndex;
+  int tcpFd;
+  int udpFd;
+  bool isConnected;
+  int playerId;
+  uint32_t token;
+  uint32_t lastTick;
+  int64_t lastArrival; // steady clock microseconds, 0 before the first snapshot
+  std::vector<uint8_t> inbound;
+  std::vector<uint8_t> outbound;
+  std::mt19937 random;
+  t_bot_stats stats;
+
+  void handlePacket(const uint8_t* data, uint32_t size, bool isDatagram);
+  void onSnapshot(uint32_t tick, uint32_t size, bool isDatagram);
+  void sendPacket(flatbuffers::FlatBufferBuilder& builder);
+  bool flush();
+  void sendHello();
+  void sendAck(uint32_t tick);
+  void sendBind();
+  void sendTurn();
+};
+
+#endif
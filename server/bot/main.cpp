@@ -0,0 +1,210 @@
+#include "../src/EventLoop.hpp"
+#include "BotSession.hpp"
+#include <algorithm>
+#include <arpa/inet.h>
+#include <chrono>
+#include <signal.h>
+#include <sys/resource.h>
+
+#define SERV_PORT 8080
+#define WAIT_TIMEOUT_MS 100
+#define PROGRESS_INTERVAL_MS 1000
+#define BOT_FEATURES (Feature_DeltaSnapshots | Feature_PackedBodies | Feature_PackedMap)
+
+using Clock = std::chrono::steady_clock;
+
+void onerror(const char* msg) {
+  write(STDERR_FILENO, msg, strlen(msg));
+  exit(EXIT_FAILURE);
+}
+
+// every session costs two fds, so lift the soft limit as far as we are allowed
+static void raiseOpenFileLimit() {
+  struct rlimit limit;
+  if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < limit.rlim_max) {
+    limit.rlim_cur = limit.rlim_max;
+    setrlimit(RLIMIT_NOFILE, &limit);
+  }
+}
+
+static int64_t percentile(const std::vector<int64_t>& sorted, double percent) {
+  if (sorted.empty())
+    return 0;
+  return sorted[(size_t)(percent / 100.0 * (sorted.size() - 1))];
+}
+
+static void printHeader() {
+  std::cout << "session,player,snapshots,udp_snapshots,stale,missed_ticks,gaps,snapshot_bytes,"
+               "avg_snapshot_bytes,max_snapshot_bytes,tcp_bytes,udp_bytes,interval_avg_us,interval_p50_us,"
+               "interval_p99_us,interval_max_us,turns,open\n";
+}
+
+static void printRow(const std::string& name, int playerId, const t_bot_stats& stats, bool isOpen) {
+  std::vector<int64_t> intervals = stats.intervals;
+  std::sort(intervals.begin(), intervals.end());
+
+  int64_t total = 0;
+  for (int64_t interval : intervals)
+    total += interval;
+
+  int64_t average = intervals.empty() ? 0 : total / (int64_t)intervals.size();
+  int64_t maximum = intervals.empty() ? 0 : intervals.back();
+  uint64_t averageBytes = stats.snapshots ? stats.snapshotBytes / stats.snapshots : 0;
+
+  std::cout << name << ',' << playerId << ',' << stats.snapshots << ',' << stats.udpSnapshots << ','
+            << stats.stale << ',' << stats.missedTicks << ',' << stats.gaps << ',' << stats.snapshotBytes
+            << ',' << averageBytes << ',' << stats.maxSnapshotBytes << ',' << stats.tcpBytes << ','
+            << stats.udpBytes << ',' << average << ',' << percentile(intervals, 50) << ','
+            << percentile(intervals, 99) << ',' << maximum << ',' << stats.turns << ',' << isOpen << '\n';
+}
+
+static void addStats(t_bot_stats& total, const t_bot_stats& stats) {
+  total.snapshots += stats.snapshots;
+  total.udpSnapshots += stats.udpSnapshots;
+  total.stale += stats.stale;
+  total.missedTicks += stats.missedTicks;
+  total.gaps += stats.gaps;
+  total.snapshotBytes += stats.snapshotBytes;
+  total.maxSnapshotBytes = std::max(total.maxSnapshotBytes, stats.maxSnapshotBytes);
+  total.tcpBytes += stats.tcpBytes;
+  total.udpBytes += stats.udpBytes;
+  total.turns += stats.turns;
+  total.intervals.insert(total.intervals.end(), stats.intervals.begin(), stats.intervals.end());
+}
+
+static void closeSession(EventLoop& eventLoop, std::unordered_map<int, BotSession*>& sessionsByFd,
+                         BotSession* session) {
+  if (!session->getIsOpen())
+    return;
+
+  std::cerr << "Session closed: " << session->getId() << std::endl;
+  eventLoop.remove(session->getTcpFd());
+  eventLoop.remove(session->getUdpFd());
+  sessionsByFd.erase(session->getTcpFd());
+  sessionsByFd.erase(session->getUdpFd());
+  session->close();
+}
+
+static void printProgress(int64_t elapsedMs, const std::vector<BotSession*>& sessions) {
+  size_t open = 0;
+  t_bot_stats total = t_bot_stats();
+  for (const BotSession* session : sessions) {
+    open += session->getIsOpen();
+    total.snapshots += session->getStats().snapshots;
+    total.missedTicks += session->getStats().missedTicks;
+    total.tcpBytes += session->getStats().tcpBytes;
+    total.udpBytes += session->getStats().udpBytes;
+  }
+
+  std::cerr << elapsedMs / 1000 << "s: " << open << "/" << sessions.size() << " sessions, " << total.snapshots
+            << " snapshots, " << total.missedTicks << " missed ticks, "
+            << (total.tcpBytes + total.udpBytes) / 1024 << " KiB" << std::endl;
+}
+
+// N synthetic players against nibbler_server from a single event loop. Each one acks its snapshots,
+// steers over UDP and keeps its own stats, printed as CSV once the run is over: one row per session
+// and a total row over all of them.
+int main(int argc, char** argv) {
+  if (argc < 3)
+    onerror("Usage: ./nibbler_bot sessions seconds [host] [turns]\n"
+            "turns: random (default) or a script of U, D, L, R and '.' played one step per tick\n");
+
+  int sessionCount = atoi(argv[1]);
+  int seconds = atoi(argv[2]);
+  if (sessionCount < 1 || seconds < 1)
+    onerror("Invalid sessions or seconds\n");
+
+  const char* host = argc >= 4 ? argv[3] : "127.0.0.1";
+  std::string script = argc >= 5 && strcmp(argv[4], "random") != 0 ? argv[4] : "";
+  if (script.find_first_not_of("UDLR.") != std::string::npos)
+    onerror("Invalid turns\n");
+
+  struct sockaddr_in serverAddr;
+  memset(&serverAddr, 0, sizeof(serverAddr));
+  serverAddr.sin_family = AF_INET;
+  serverAddr.sin_port = htons(SERV_PORT);
+  if (inet_pton(AF_INET, host, &serverAddr.sin_addr) != 1)
+    onerror("Invalid host\n");
+
+  // NIBBLER_BOT_TCP=1 keeps every snapshot on TCP, for comparing both transports
+  const char* tcpOnly = getenv("NIBBLER_BOT_TCP");
+  uint32_t features = BOT_FEATURES;
+  if (!tcpOnly || strcmp(tcpOnly, "0") == 0)
+    features |= Feature_UdpSnapshots;
+
+  signal(SIGPIPE, SIG_IGN);
+  raiseOpenFileLimit();
+
+  EventLoop eventLoop;
+  std::vector<BotSession*> sessions;
+  std::unordered_map<int, BotSession*> sessionsByFd;
+
+  for (int id = 0; id < sessionCount; id++) {
+    BotSession* session = new BotSession(id, serverAddr, features, script);
+    sessions.push_back(session);
+
+    if (!session->open() || !eventLoop.add(session->getTcpFd(), EVENT_READ | EVENT_WRITE) ||
+        !eventLoop.add(session->getUdpFd(), EVENT_READ)) {
+      std::cerr << "Failed to open session " << id << ": " << strerror(errno) << std::endl;
+      session->close();
+      continue;
+    }
+    sessionsByFd[session->getTcpFd()] = session;
+    sessionsByFd[session->getUdpFd()] = session;
+  }
+
+  auto begin = Clock::now();
+  auto deadline = begin + std::chrono::seconds(seconds);
+  auto nextProgress = begin + std::chrono::milliseconds(PROGRESS_INTERVAL_MS);
+
+  while (Clock::now() < deadline) {
+    int count = eventLoop.wait(WAIT_TIMEOUT_MS);
+    if (count < 0)
+      onerror("Failed to wait for events\n");
+
+    for (int i = 0; i < count; i++) {
+      const t_ioevent& event = eventLoop.getEvent(i);
+      auto found = sessionsByFd.find(event.fd);
+      if (found == sessionsByFd.end())
+        continue;
+
+      BotSession* session = found->second;
+      if (event.fd == session->getUdpFd()) {
+        session->onDatagrams();
+      } else {
+        bool isAlive = !(event.events & EVENT_ERROR);
+        if (isAlive && (event.events & EVENT_WRITE))
+          isAlive = session->onWritable();
+        if (isAlive && (event.events & EVENT_READ))
+          isAlive = session->onReadable();
+        if (!isAlive) {
+          closeSession(eventLoop, sessionsByFd, session);
+          continue;
+        }
+      }
+
+      // write interest only while something waits, the poll fallback would spin on it otherwise
+      if (session->getIsOpen())
+        eventLoop.modify(session->getTcpFd(), EVENT_READ | (session->hasPendingOutput() ? EVENT_WRITE : 0));
+    }
+
+    if (Clock::now() >= nextProgress) {
+      printProgress(std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - begin).count(),
+                    sessions);
+      nextProgress += std::chrono::milliseconds(PROGRESS_INTERVAL_MS);
+    }
+  }
+
+  printHeader();
+  t_bot_stats total = t_bot_stats();
+  for (BotSession* session : sessions) {
+    printRow(std::to_string(session->getId()), session->getPlayerId(), session->getStats(),
+             session->getIsOpen());
+    addStats(total, session->getStats());
+  }
+  printRow("total", -1, total, true);
+  std::cout << std::flush;
+
+  for (BotSession* session : sessions)
+    delete session;
+}
@@ -11,6 +11,7 @@
 #include <netinet/tcp.h>
 #include <optional>
 #include <poll.h>
+#include <random>
 #include <stdio.h>
 #include <string.h>
 #include <string>
@@ -33,7 +34,22 @@
 #define WALL_VERTI_TILE 'V'
 
 #define SNAKE_SPEED 300
-#define MAX_PLAYERS 10
+#define SNAKE_INITIAL_LENGTH 4
+#ifndef MAX_PLAYERS
+#define MAX_PLAYERS 10 // per room
+#endif
+
+#ifndef MAX_ROOMS
+#define MAX_ROOMS 256
+#endif
+
+#ifndef SEND_QUEUE_BUDGET
+#define SEND_QUEUE_BUDGET (128 * 1024)
+#endif
+
+// Length prefix + payload, never modified once built. Every send queue the frame waits in
+// shares the same buffer.
+typedef std::shared_ptr<const std::vector<uint8_t>> t_frame_buffer;
 
 typedef struct s_coordinates {
   int x;
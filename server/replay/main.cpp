@@ -0,0 +1,68 @@
+#include "../src/RoomManager.hpp"
+#include "../src/Replay.hpp"
+#include <chrono>
+
+using Clock = std::chrono::steady_clock;
+
+void onerror(const char* msg) {
+  write(STDERR_FILENO, msg, strlen(msg));
+  exit(EXIT_FAILURE);
+}
+
+// Plays a recording made with NIBBLER_REPLAY=path back as fast as the tick workers go, no sleeps
+// and no sockets. The same seed, map and per-tick inputs give the same rooms, every checkpoint of
+// the recording is compared with the state reached. Exits with 1 once a room diverged.
+int main(int argc, char** argv) {
+  if (argc < 2)
+    onerror("Usage: ./nibbler_replay file\n"
+            "NIBBLER_WORKERS sets the tick workers as for the server, one per core by default\n");
+
+  const char* workers = getenv("NIBBLER_WORKERS");
+  size_t workerCount = workers ? atoi(workers) : std::thread::hardware_concurrency();
+
+  // the game logs to std::cout, the report goes straight to stdout
+  std::streambuf* gameLog = std::cout.rdbuf(nullptr);
+
+  t_replay_stats stats;
+  double elapsedMs;
+  bool isTruncated;
+  try {
+    ReplayReader reader(argv[1]);
+    const t_replay_header& header = reader.getHeader();
+    printf("Seed: %llu, map: %s %dx%d, workers: %zu\n", (unsigned long long)header.seed,
+           header.mapPath.empty() ? "(none)" : header.mapPath.c_str(), header.height, header.width,
+           workerCount ? workerCount : 1);
+
+    RoomManager rooms(header.height, header.width, header.mapPath, workerCount, header.seed);
+
+    auto begin = Clock::now();
+    stats = rooms.replay(reader);
+    elapsedMs = std::chrono::duration<double, std::milli>(Clock::now() - begin).count();
+    isTruncated = reader.getIsTruncated();
+  } catch (const char* err) {
+    std::cout.rdbuf(gameLog);
+    std::cerr << err << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  std::cout.rdbuf(gameLog);
+  std::cout.clear();
+
+  double seconds = elapsedMs / 1000;
+  printf("Ticks: %llu, room ticks: %llu, snake moves: %llu, commands: %llu\n",
+         (unsigned long long)stats.ticks, (unsigned long long)stats.roomTicks,
+         (unsigned long long)stats.snakeMoves, (unsigned long long)stats.commands);
+  printf("Elapsed: %.1f ms, %.0f ticks/s, %.0f room ticks/s, %.0f snake moves/s\n", elapsedMs,
+         seconds > 0 ? stats.ticks / seconds : 0, seconds > 0 ? stats.roomTicks / seconds : 0,
+         seconds > 0 ? stats.snakeMoves / seconds : 0);
+  if (isTruncated)
+    printf("Last record cut short, played up to it\n");
+
+  if (stats.mismatches) {
+    printf("Checkpoints: %llu, diverged: %llu, first at tick %u in room %d\n",
+           (unsigned long long)stats.checkpoints, (unsigned long long)stats.mismatches,
+           stats.firstMismatchTick, stats.firstMismatchRoom);
+    return EXIT_FAILURE;
+  }
+  printf("Checkpoints: %llu, all match\n", (unsigned long long)stats.checkpoints);
+}
@@ -0,0 +1,27 @@
+#include "CommandQueue.hpp"
+
+CommandQueue::CommandQueue() : head(0), tail(0) {}
+
+CommandQueue::~CommandQueue() {}
+
+// Producer side, false when the ring is full
+bool CommandQueue::push(const t_command& command) {
+  size_t tail = this->tail.load(std::memory_order_relaxed);
+  if (tail - this->head.load(std::memory_order_acquire) == COMMAND_QUEUE_SIZE)
+    return false;
+
+  this->slots[tail & (COMMAND_QUEUE_SIZE - 1)] = command;
+  this->tail.store(tail + 1, std::memory_order_release);
+  return true;
+}
+
+// Consumer side, false when the ring is empty
+bool CommandQueue::pop(t_command& command) {
+  size_t head = this->head.load(std::memory_order_relaxed);
+  if (head == this->tail.load(std::memory_order_acquire))
+    return false;
+
+  command = this->slots[head & (COMMAND_QUEUE_SIZE - 1)];
+  this->head.store(head + 1, std::memory_order_release);
+  return true;
+}
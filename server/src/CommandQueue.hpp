@@ -0,0 +1,36 @@
+#ifndef COMMAND_QUEUE_HPP
+#define COMMAND_QUEUE_HPP
+
+#include "../includes/nibbler.hpp"
+
+#define COMMAND_QUEUE_SIZE 4096 // power of two
+
+enum e_command { COMMAND_JOIN, COMMAND_LEAVE, COMMAND_DIRECTION };
+
+typedef struct s_command {
+  e_command type;
+  int id;    // snake id, the client fd
+  int value; // direction for COMMAND_DIRECTION, initial length for COMMAND_JOIN
+} t_command;
+
+// Bounded single-producer single-consumer ring. The network thread pushes, the game thread
+// pops, neither ever blocks the other.
+class CommandQueue {
+public:
+  CommandQueue();
+  CommandQueue(const CommandQueue& obj) = delete;
+  CommandQueue& operator=(const CommandQueue& obj) = delete;
+  CommandQueue(CommandQueue&& obj) = delete;
+  CommandQueue& operator=(CommandQueue&& obj) = delete;
+  ~CommandQueue();
+
+  bool push(const t_command& command);
+  bool pop(t_command& command);
+
+private:
+  t_command slots[COMMAND_QUEUE_SIZE];
+  alignas(64) std::atomic<size_t> head; // next slot to pop, written by the consumer
+  alignas(64) std::atomic<size_t> tail; // next slot to push, written by the producer
+};
+
+#endif
@@ -0,0 +1,283 @@
+#include "Connection.hpp"
+#include <errno.h>
+#ifdef __linux__
+#include <linux/errqueue.h>
+#endif
+
+#define MAX_FLUSH_FRAMES 16
+#define RECEIVE_CHUNK_SIZE 512
+#define MAX_INBOUND_PACKET 1024
+#define MAX_RECEIVE_BYTES (4 * RECEIVE_CHUNK_SIZE) // read per call before the packets are handed out
+#define COMPLETION_CONTROL_SIZE 128
+
+// Below this a batch is cheaper to copy than to pin and wait for
+#ifndef ZEROCOPY_MIN_BYTES
+#define ZEROCOPY_MIN_BYTES 4096
+#endif
+
+Connection::Connection(int fd, in_addr_t address)
+    : fd(fd), slot(0), roomId(0), pendingBytes(0), isWatchingWrite(false), inboundOffset(0), features(0), ackedTick(0),
+      isMapSent(false), token(0), endpoint(0), address(address), datagramTick(0), isDatagramBlocked(false), isZerocopy(false),
+      nextZerocopyId(0) {}
+
+Connection::~Connection() {}
+
+#ifdef MSG_ZEROCOPY
+static size_t totalLength(const struct iovec* iov, int iovcnt) {
+  size_t length = 0;
+  for (int i = 0; i < iovcnt; i++)
+    length += iov[i].iov_len;
+  return length;
+}
+#endif
+
+// Returns false when the socket is broken and the connection has to be closed
+bool Connection::send(const t_frame_buffer& frame, bool isSnapshot) {
+  bool isWaiting = !this->queue.empty();
+
+  // a slow client only needs the newest snapshot
+  if (isWaiting && isSnapshot)
+    dropStaleSnapshots();
+
+  // queued by reference, whatever the socket does not take right away is never copied
+  this->queue.push_back({frame, 0, isSnapshot});
+  this->pendingBytes += frame->size();
+
+  // behind other frames it waits for the next writable event
+  return isWaiting || flush();
+}
+
+// Resumes queued frames, returns false when the socket is broken
+bool Connection::flush() {
+  while (!this->queue.empty()) {
+    struct iovec iov[MAX_FLUSH_FRAMES];
+    int iovcnt = 0;
+
+    for (auto it = this->queue.begin(); it != this->queue.end() && iovcnt < MAX_FLUSH_FRAMES; ++it, ++iovcnt) {
+      iov[iovcnt].iov_base = const_cast<uint8_t*>(it->buffer->data()) + it->offset;
+      iov[iovcnt].iov_len = it->buffer->size() - it->offset;
+    }
+
+    ssize_t bytesWritten = write(iov, iovcnt);
+    if (bytesWritten == -1 && errno == EINTR)
+      continue;
+    if (bytesWritten == -1)
+      return errno == EAGAIN || errno == EWOULDBLOCK;
+
+    this->pendingBytes -= bytesWritten;
+
+    while (bytesWritten > 0) {
+      t_frame& front = this->queue.front();
+      size_t left = front.buffer->size() - front.offset;
+
+      if ((size_t)bytesWritten < left) {
+        front.offset += bytesWritten;
+        break;
+      }
+
+      bytesWritten -= left;
+      this->queue.pop_front();
+    }
+  }
+
+  return true;
+}
+
+static uint32_t readLength(const uint8_t* data) {
+  uint32_t sizeNetwork;
+  memcpy(&sizeNetwork, data, sizeof(sizeNetwork));
+  return ntohl(sizeNetwork);
+}
+
+// Reads at most MAX_RECEIVE_BYTES, RECEIVE_MORE when the socket may still hold some. Each length
+// prefix is checked as soon as it is complete, a packet over MAX_INBOUND_PACKET closes the
+// connection before its body is buffered.
+enum e_receive Connection::receive() {
+  this->inbound.erase(this->inbound.begin(), this->inbound.begin() + this->inboundOffset);
+  this->inboundOffset = 0;
+
+  size_t offset = 0; // next length prefix, the buffer starts on a packet
+  size_t received = 0;
+  while (received < MAX_RECEIVE_BYTES) {
+    size_t used = this->inbound.size();
+    this->inbound.resize(used + RECEIVE_CHUNK_SIZE);
+
+    ssize_t n = recv(this->fd, this->inbound.data() + used, RECEIVE_CHUNK_SIZE, 0);
+    this->inbound.resize(used + (n > 0 ? n : 0));
+
+    if (n > 0) {
+      received += n;
+      while (offset + sizeof(uint32_t) <= this->inbound.size()) {
+        uint32_t size = readLength(this->inbound.data() + offset);
+        if (size > MAX_INBOUND_PACKET)
+          return RECEIVE_CLOSED;
+        offset += sizeof(uint32_t) + size;
+      }
+      continue;
+    }
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+      return RECEIVE_DRAINED;
+    return RECEIVE_CLOSED;
+  }
+  return RECEIVE_MORE;
+}
+
+// Hands out the next complete packet, valid until the next receive()
+bool Connection::nextPacket(const uint8_t*& data, uint32_t& size) {
+  size_t available = this->inbound.size() - this->inboundOffset;
+  if (available < sizeof(uint32_t))
+    return false;
+
+  size = readLength(this->inbound.data() + this->inboundOffset);
+  if (available - sizeof(uint32_t) < size)
+    return false;
+
+  data = this->inbound.data() + this->inboundOffset + sizeof(uint32_t);
+  this->inboundOffset += sizeof(uint32_t) + size;
+  return true;
+}
+
+// The iov covers the front of the queue. A zerocopy send pins those buffers until its completion.
+ssize_t Connection::write(const struct iovec* iov, int iovcnt) {
+#ifdef MSG_ZEROCOPY
+  if (this->isZerocopy && totalLength(iov, iovcnt) >= ZEROCOPY_MIN_BYTES) {
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = const_cast<struct iovec*>(iov);
+    msg.msg_iovlen = iovcnt;
+
+    ssize_t bytesWritten = sendmsg(this->fd, &msg, MSG_ZEROCOPY);
+    if (bytesWritten > 0) {
+      t_zerocopy_send pending;
+      pending.id = this->nextZerocopyId++;
+      for (int i = 0; i < iovcnt; i++)
+        pending.buffers.push_back(this->queue[i].buffer);
+      this->zerocopySends.push_back(std::move(pending));
+      return bytesWritten;
+    }
+
+    // out of memory to pin pages, this batch is copied
+    if (bytesWritten == 0 || errno != ENOBUFS)
+      return bytesWritten;
+  }
+#endif
+
+  return writev(this->fd, iov, iovcnt);
+}
+
+bool Connection::enableZerocopy() {
+#ifdef SO_ZEROCOPY
+  int flag = 1;
+  if (setsockopt(this->fd, SOL_SOCKET, SO_ZEROCOPY, &flag, sizeof(flag)) == 0)
+    this->isZerocopy = true;
+#endif
+  return this->isZerocopy;
+}
+
+// Completions arrive on the error queue as ranges of send ids. Returns false when the queue
+// holds a real error or the socket has one pending.
+bool Connection::readCompletions() {
+#ifdef SO_EE_ORIGIN_ZEROCOPY
+  while (this->isZerocopy) {
+    char control[COMPLETION_CONTROL_SIZE];
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+
+    if (recvmsg(this->fd, &msg, MSG_ERRQUEUE) == -1) {
+      if (errno == EINTR)
+        continue;
+      break;
+    }
+
+    for (struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+      if (!(cmsg->cmsg_level == SOL_IP && cmsg->cmsg_type == IP_RECVERR) &&
+          !(cmsg->cmsg_level == SOL_IPV6 && cmsg->cmsg_type == IPV6_RECVERR))
+        continue;
+
+      const struct sock_extended_err* error = (const struct sock_extended_err*)CMSG_DATA(cmsg);
+      if (error->ee_origin != SO_EE_ORIGIN_ZEROCOPY || error->ee_errno != 0)
+        return false;
+
+      // ee_info to ee_data, inclusive. Ids wrap, so the range is compared as distances.
+      uint32_t first = error->ee_info;
+      uint32_t span = error->ee_data - first;
+      for (auto it = this->zerocopySends.begin(); it != this->zerocopySends.end();) {
+        if (it->id - first <= span)
+          it = this->zerocopySends.erase(it);
+        else
+          ++it;
+      }
+    }
+  }
+#endif
+
+  int error = 0;
+  socklen_t errorLen = sizeof(error);
+  getsockopt(this->fd, SOL_SOCKET, SO_ERROR, &error, &errorLen);
+  return error == 0;
+}
+
+// Snapshots that have not been started yet are superseded by a newer one
+void Connection::dropStaleSnapshots() {
+  for (auto it = this->queue.begin(); it != this->queue.end();) {
+    if (it->isSnapshot && it->offset == 0) {
+      this->pendingBytes -= it->buffer->size();
+      it = this->queue.erase(it);
+    } else
+      ++it;
+  }
+}
+
+int Connection::getFd() const { return this->fd; }
+
+size_t Connection::getSlot() const { return this->slot; }
+
+void Connection::setSlot(size_t slot) { this->slot = slot; }
+
+int Connection::getRoomId() const { return this->roomId; }
+
+void Connection::setRoomId(int roomId) { this->roomId = roomId; }
+
+bool Connection::hasPendingData() const { return !this->queue.empty(); }
+
+size_t Connection::getPendingBytes() const { return this->pendingBytes; }
+
+bool Connection::getIsWatchingWrite() const { return this->isWatchingWrite; }
+
+void Connection::setIsWatchingWrite(bool value) { this->isWatchingWrite = value; }
+
+uint32_t Connection::getFeatures() const { return this->features; }
+
+void Connection::setFeatures(uint32_t features) { this->features = features; }
+
+uint32_t Connection::getAckedTick() const { return this->ackedTick; }
+
+void Connection::setAckedTick(uint32_t tick) { this->ackedTick = tick; }
+
+bool Connection::getIsMapSent() const { return this->isMapSent; }
+
+void Connection::setIsMapSent(bool value) { this->isMapSent = value; }
+
+uint32_t Connection::getToken() const { return this->token; }
+
+void Connection::setToken(uint32_t token) { this->token = token; }
+
+uint64_t Connection::getEndpoint() const { return this->endpoint; }
+
+void Connection::setEndpoint(uint64_t endpoint) { this->endpoint = endpoint; }
+
+in_addr_t Connection::getAddress() const { return this->address; }
+
+uint32_t Connection::getDatagramTick() const { return this->datagramTick; }
+
+void Connection::setDatagramTick(uint32_t tick) { this->datagramTick = tick; }
+
+bool Connection::getIsDatagramBlocked() const { return this->isDatagramBlocked; }
+
+void Connection::setIsDatagramBlocked(bool value) { this->isDatagramBlocked = value; }
+
+bool Connection::getIsZerocopy() const { return this->isZerocopy; }
@@ -0,0 +1,92 @@
+#ifndef CONNECTION_HPP
+#define CONNECTION_HPP
+
+#include "../includes/nibbler.hpp"
+#include <deque>
+#include <sys/uio.h>
+
+typedef struct s_frame {
+  t_frame_buffer buffer;
+  size_t offset; // bytes already written to the socket
+  bool isSnapshot;
+} t_frame;
+
+typedef struct s_zerocopy_send {
+  uint32_t id;                         // the socket counts its zerocopy sends from 0
+  std::vector<t_frame_buffer> buffers; // pinned until the kernel reports the send complete
+} t_zerocopy_send;
+
+enum e_receive { RECEIVE_DRAINED, RECEIVE_MORE, RECEIVE_CLOSED };
+
+// Client socket. Frames that cannot be written right away are queued and resumed on the next
+// writable event, so a frame is never cut in half on the stream. Inbound bytes are buffered
+// until a whole length-prefixed packet has arrived. With zerocopy the kernel reads the frames
+// straight from their buffers, which stay alive until the error queue confirms the send.
+class Connection {
+public:
+  Connection(int fd, in_addr_t address);
+  Connection(const Connection& obj) = delete;
+  Connection& operator=(const Connection& obj) = delete;
+  Connection(Connection&& obj) = delete;
+  Connection& operator=(Connection&& obj) = delete;
+  ~Connection();
+
+  bool send(const t_frame_buffer& frame, bool isSnapshot);
+  bool flush();
+  bool enableZerocopy();
+  bool readCompletions();
+  enum e_receive receive();
+  bool nextPacket(const uint8_t*& data, uint32_t& size);
+
+  int getFd() const;
+  size_t getSlot() const;
+  void setSlot(size_t slot);
+  int getRoomId() const;
+  void setRoomId(int roomId);
+  bool hasPendingData() const;
+  size_t getPendingBytes() const;
+  bool getIsWatchingWrite() const;
+  void setIsWatchingWrite(bool value);
+  uint32_t getFeatures() const;
+  void setFeatures(uint32_t features);
+  uint32_t getAckedTick() const;
+  void setAckedTick(uint32_t tick);
+  bool getIsMapSent() const;
+  void setIsMapSent(bool value);
+  uint32_t getToken() const;
+  void setToken(uint32_t token);
+  uint64_t getEndpoint() const;
+  void setEndpoint(uint64_t endpoint);
+  in_addr_t getAddress() const;
+  uint32_t getDatagramTick() const;
+  void setDatagramTick(uint32_t tick);
+  bool getIsDatagramBlocked() const;
+  void setIsDatagramBlocked(bool value);
+  bool getIsZerocopy() const;
+
+private:
+  int fd;
+  size_t slot; // position in Server::clientFds
+  int roomId;  // the game the client was matched into
+  std::deque<t_frame> queue;
+  size_t pendingBytes;
+  bool isWatchingWrite;
+  std::vector<uint8_t> inbound;
+  size_t inboundOffset; // bytes already handed out by nextPacket
+  uint32_t features;    // Feature flags the client asked for in Hello
+  uint32_t ackedTick;   // newest snapshot the client confirmed, 0 if none
+  bool isMapSent;
+  uint32_t token;          // session token handed out in Welcome, UDP inputs must carry it
+  uint64_t endpoint;       // UDP (ip, port) bound to the session, 0 until the first input
+  in_addr_t address;       // TCP peer ip, the key of its tokenless input fallback
+  uint32_t datagramTick;   // first snapshot sent over UDP, 0 if none
+  bool isDatagramBlocked;  // UDP snapshots went unacked, TCP for the rest of the session
+  bool isZerocopy;
+  uint32_t nextZerocopyId;
+  std::deque<t_zerocopy_send> zerocopySends;
+
+  ssize_t write(const struct iovec* iov, int iovcnt);
+  void dropStaleSnapshots();
+};
+
+#endif
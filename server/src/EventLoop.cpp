@@ -0,0 +1,139 @@
+#include "EventLoop.hpp"
+#include <errno.h>
+
+#define MAX_EVENTS_PER_WAIT 1024
+
+#ifdef __linux__
+
+static uint32_t toEpollEvents(int events) {
+  uint32_t epollEvents = EPOLLET;
+  if (events & EVENT_READ)
+    epollEvents |= EPOLLIN;
+  if (events & EVENT_WRITE)
+    epollEvents |= EPOLLOUT;
+  return epollEvents;
+}
+
+EventLoop::EventLoop() : epollEvents(MAX_EVENTS_PER_WAIT) {
+  this->epollFd = epoll_create1(EPOLL_CLOEXEC);
+  if (this->epollFd == -1)
+    throw "Failed to create epoll instance";
+}
+
+EventLoop::~EventLoop() { close(this->epollFd); }
+
+bool EventLoop::add(int fd, int events) {
+  struct epoll_event event;
+  event.events = toEpollEvents(events);
+  event.data.fd = fd;
+  return epoll_ctl(this->epollFd, EPOLL_CTL_ADD, fd, &event) == 0;
+}
+
+bool EventLoop::modify(int fd, int events) {
+  struct epoll_event event;
+  event.events = toEpollEvents(events);
+  event.data.fd = fd;
+  return epoll_ctl(this->epollFd, EPOLL_CTL_MOD, fd, &event) == 0;
+}
+
+void EventLoop::remove(int fd) { epoll_ctl(this->epollFd, EPOLL_CTL_DEL, fd, nullptr); }
+
+int EventLoop::wait(int timeoutMs) {
+  int count = epoll_wait(this->epollFd, this->epollEvents.data(), this->epollEvents.size(), timeoutMs);
+  if (count < 0)
+    return errno == EINTR ? 0 : -1;
+
+  this->readyEvents.resize(count);
+  for (int i = 0; i < count; i++) {
+    uint32_t flags = this->epollEvents[i].events;
+    t_ioevent& ready = this->readyEvents[i];
+
+    ready.fd = this->epollEvents[i].data.fd;
+    ready.events = 0;
+    if (flags & EPOLLIN)
+      ready.events |= EVENT_READ;
+    if (flags & EPOLLOUT)
+      ready.events |= EVENT_WRITE;
+    if (flags & (EPOLLERR | EPOLLHUP))
+      ready.events |= EVENT_ERROR;
+  }
+
+  return count;
+}
+
+#else
+
+static short toPollEvents(int events) {
+  short pollEvents = 0;
+  if (events & EVENT_READ)
+    pollEvents |= POLLIN;
+  if (events & EVENT_WRITE)
+    pollEvents |= POLLOUT;
+  return pollEvents;
+}
+
+EventLoop::EventLoop() {}
+
+EventLoop::~EventLoop() {}
+
+bool EventLoop::add(int fd, int events) {
+  if (fd < 0)
+    return false;
+
+  if ((int)this->fdToIndex.size() <= fd)
+    this->fdToIndex.resize(fd + 1, -1);
+  if (this->fdToIndex[fd] != -1)
+    return false;
+
+  this->fdToIndex[fd] = this->pollFds.size();
+  this->pollFds.push_back({fd, toPollEvents(events), 0});
+  return true;
+}
+
+bool EventLoop::modify(int fd, int events) {
+  if (fd < 0 || (int)this->fdToIndex.size() <= fd || this->fdToIndex[fd] == -1)
+    return false;
+
+  this->pollFds[this->fdToIndex[fd]].events = toPollEvents(events);
+  return true;
+}
+
+// swap with the last entry so removal stays O(1)
+void EventLoop::remove(int fd) {
+  if (fd < 0 || (int)this->fdToIndex.size() <= fd || this->fdToIndex[fd] == -1)
+    return;
+
+  int index = this->fdToIndex[fd];
+  this->pollFds[index] = this->pollFds.back();
+  this->fdToIndex[this->pollFds[index].fd] = index;
+  this->pollFds.pop_back();
+  this->fdToIndex[fd] = -1;
+}
+
+int EventLoop::wait(int timeoutMs) {
+  int count = poll(this->pollFds.data(), this->pollFds.size(), timeoutMs);
+  if (count < 0)
+    return errno == EINTR ? 0 : -1;
+
+  this->readyEvents.clear();
+  for (size_t i = 0; i < this->pollFds.size() && (int)this->readyEvents.size() < count; i++) {
+    short flags = this->pollFds[i].revents;
+    if (!flags)
+      continue;
+
+    t_ioevent ready = {this->pollFds[i].fd, 0};
+    if (flags & POLLIN)
+      ready.events |= EVENT_READ;
+    if (flags & POLLOUT)
+      ready.events |= EVENT_WRITE;
+    if (flags & (POLLERR | POLLHUP | POLLNVAL))
+      ready.events |= EVENT_ERROR;
+    this->readyEvents.push_back(ready);
+  }
+
+  return this->readyEvents.size();
+}
+
+#endif
+
+const t_ioevent& EventLoop::getEvent(int index) const { return this->readyEvents[index]; }
@@ -0,0 +1,49 @@
+#ifndef EVENTLOOP_HPP
+#define EVENTLOOP_HPP
+
+#include "../includes/nibbler.hpp"
+
+#ifdef __linux__
+#include <sys/epoll.h>
+#endif
+
+#define EVENT_READ 0x1
+#define EVENT_WRITE 0x2
+#define EVENT_ERROR 0x4
+
+typedef struct s_ioevent {
+  int fd;
+  int events;
+} t_ioevent;
+
+// Readiness is edge-triggered on Linux (epoll): a handler must drain its fd until EAGAIN,
+// otherwise it will not be reported again. Other platforms fall back to poll().
+class EventLoop {
+public:
+  EventLoop();
+  EventLoop(const EventLoop& obj) = delete;
+  EventLoop& operator=(const EventLoop& obj) = delete;
+  EventLoop(EventLoop&& obj) = delete;
+  EventLoop& operator=(EventLoop&& obj) = delete;
+  ~EventLoop();
+
+  bool add(int fd, int events);
+  bool modify(int fd, int events);
+  void remove(int fd);
+  int wait(int timeoutMs);
+
+  const t_ioevent& getEvent(int index) const;
+
+private:
+  std::vector<t_ioevent> readyEvents;
+
+#ifdef __linux__
+  int epollFd;
+  std::vector<struct epoll_event> epollEvents;
+#else
+  std::vector<struct pollfd> pollFds;
+  std::vector<int> fdToIndex;
+#endif
+};
+
+#endif
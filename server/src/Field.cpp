@@ -0,0 +1,64 @@
+#include "Field.hpp"
+#include <algorithm>
+
+#define PICK_ATTEMPTS 16
+#define PICKS_PER_COVERED 2 // a random pick costs about half of what ranking a covered cell does
+
+Field::Field(std::shared_ptr<const Grid> walls) : walls(walls) {}
+
+Field::~Field() {}
+
+char Field::getTile(int x, int y) const {
+  auto cell = this->covered.find(this->walls->index(x, y));
+  return cell != this->covered.end() ? cell->second.tile : this->walls->getTile(x, y);
+}
+
+int Field::getOwner(int x, int y) const {
+  auto cell = this->covered.find(this->walls->index(x, y));
+  return cell != this->covered.end() ? cell->second.owner : NO_OWNER;
+}
+
+// Walls are never overwritten, a floor tile uncovers the cell
+void Field::setTile(int x, int y, char tile, int owner) {
+  uint32_t i = this->walls->index(x, y);
+  if ((*this->walls)[i].tile != FLOOR_TILE)
+    return;
+
+  if (tile == FLOOR_TILE)
+    this->covered.erase(i);
+  else
+    this->covered[i] = {tile, owner};
+}
+
+// Uniform over the uncovered floor cells, fails only when there is none. Random picks over the
+// map's floor are retried while they land on covered cells, for about what the fallback costs. It
+// draws the rank of the cell among the uncovered ones and skips the covered slots of the wall
+// grid's free index below it, O(covered) rather than a scan of the map.
+bool Field::pickFreeCell(int& x, int& y, std::mt19937& random) const {
+  size_t freeCount = this->walls->getFreeCount();
+  if (this->covered.size() >= freeCount)
+    return false;
+
+  size_t attempts = PICK_ATTEMPTS + this->covered.size() * PICKS_PER_COVERED;
+  for (size_t attempt = 0; attempt < attempts; attempt++) {
+    if (this->walls->pickFreeCell(x, y, random) && !this->covered.count(this->walls->index(x, y)))
+      return true;
+  }
+
+  this->coveredSlots.clear();
+  for (const auto& cell : this->covered)
+    this->coveredSlots.push_back(this->walls->getFreeSlot(cell.first));
+  std::sort(this->coveredSlots.begin(), this->coveredSlots.end());
+
+  size_t slot = random() % (freeCount - this->covered.size());
+  for (uint32_t coveredSlot : this->coveredSlots) {
+    if (coveredSlot > slot)
+      break;
+    slot++;
+  }
+
+  uint32_t i = this->walls->getFreeCell(slot);
+  x = i % getWidth();
+  y = i / getWidth();
+  return true;
+}
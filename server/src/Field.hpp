@@ -0,0 +1,35 @@
+#ifndef FIELD_HPP
+#define FIELD_HPP
+
+#include "../includes/nibbler.hpp"
+#include "Grid.hpp"
+
+// One room's view of the map: the shared walls, read-only, plus the cells its snakes and food
+// cover. Only covered cells are stored, so a room costs memory per player rather than per cell.
+class Field {
+public:
+  Field(std::shared_ptr<const Grid> walls);
+  Field(const Field& obj) = delete;
+  Field& operator=(const Field& obj) = delete;
+  Field(Field&& obj) = delete;
+  Field& operator=(Field&& obj) = delete;
+  ~Field();
+
+  bool pickFreeCell(int& x, int& y, std::mt19937& random) const;
+
+  int getWidth() const { return this->walls->getWidth(); }
+  int getHeight() const { return this->walls->getHeight(); }
+  bool isInside(int x, int y) const { return this->walls->isInside(x, y); }
+  bool isFree(int x, int y) const { return isInside(x, y) && getTile(x, y) == FLOOR_TILE; }
+
+  char getTile(int x, int y) const;
+  int getOwner(int x, int y) const;
+  void setTile(int x, int y, char tile, int owner = NO_OWNER);
+
+private:
+  std::shared_ptr<const Grid> walls;
+  std::unordered_map<uint32_t, t_cell> covered; // by cell index, never holds a floor tile
+  mutable std::vector<uint32_t> coveredSlots;   // pickFreeCell scratch, sorted positions in the free index
+};
+
+#endif
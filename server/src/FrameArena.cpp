@@ -0,0 +1,53 @@
+#include "FrameArena.hpp"
+#include <algorithm>
+
+#define ARENA_ALIGNMENT 16
+
+static size_t alignUp(size_t size) { return (size + ARENA_ALIGNMENT - 1) & ~(size_t)(ARENA_ALIGNMENT - 1); }
+
+FrameArena::FrameArena(size_t capacity)
+    : block(new uint8_t[alignUp(capacity)]), capacity(alignUp(capacity)), used(0), spilled(0) {}
+
+FrameArena::~FrameArena() {
+  for (uint8_t* p : this->overflow)
+    delete[] p;
+  delete[] this->block;
+}
+
+uint8_t* FrameArena::allocate(size_t size) {
+  size = alignUp(size);
+
+  if (this->capacity - this->used < size) {
+    this->spilled += size;
+    this->overflow.push_back(new uint8_t[size]);
+    return this->overflow.back();
+  }
+
+  uint8_t* p = this->block + this->used;
+  this->used += size;
+  return p;
+}
+
+// Given back in bulk by rewind()
+void FrameArena::deallocate(uint8_t* p, size_t size) {
+  (void)p;
+  (void)size;
+}
+
+// Everything handed out since the last rewind has to be dead by now
+void FrameArena::rewind() {
+  for (uint8_t* p : this->overflow)
+    delete[] p;
+  this->overflow.clear();
+
+  if (this->spilled) {
+    delete[] this->block;
+    this->capacity = std::max(this->capacity * 2, alignUp(this->used + this->spilled));
+    this->block = new uint8_t[this->capacity];
+  }
+
+  this->used = 0;
+  this->spilled = 0;
+}
+
+size_t FrameArena::getCapacity() const { return this->capacity; }
@@ -0,0 +1,35 @@
+#ifndef FRAMEARENA_HPP
+#define FRAMEARENA_HPP
+
+#include "../includes/nibbler.hpp"
+
+#define FRAME_ARENA_INITIAL_SIZE (16 * 1024)
+
+// Bump allocator behind the persistent FlatBufferBuilder. Nothing is freed on its own, rewind()
+// takes the whole block back once the builder has let go of it. Allocations that do not fit
+// spill to the heap and the block grows to cover them on the next rewind, so a steady tick
+// allocates nothing.
+class FrameArena : public flatbuffers::Allocator {
+public:
+  FrameArena(size_t capacity = FRAME_ARENA_INITIAL_SIZE);
+  FrameArena(const FrameArena& obj) = delete;
+  FrameArena& operator=(const FrameArena& obj) = delete;
+  FrameArena(FrameArena&& obj) = delete;
+  FrameArena& operator=(FrameArena&& obj) = delete;
+  ~FrameArena();
+
+  uint8_t* allocate(size_t size) override;
+  void deallocate(uint8_t* p, size_t size) override;
+  void rewind();
+
+  size_t getCapacity() const;
+
+private:
+  uint8_t* block;
+  size_t capacity;
+  size_t used;
+  size_t spilled; // bytes that did not fit since the last rewind
+  std::vector<uint8_t*> overflow;
+};
+
+#endif
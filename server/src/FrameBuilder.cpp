@@ -0,0 +1,47 @@
+#include "FrameBuilder.hpp"
+
+FrameBuilder::FrameBuilder() : builder(FRAME_BUILDER_INITIAL_SIZE, &arena) {}
+
+FrameBuilder::~FrameBuilder() {}
+
+// The builder keeps its buffer between frames, only the contents are dropped
+flatbuffers::FlatBufferBuilder& FrameBuilder::start(bool forceDefaults) {
+  this->builder.Clear();
+  this->builder.ForceDefaults(forceDefaults);
+  return this->builder;
+}
+
+// Length prefix and payload in one buffer, so a frame goes out with a single write. Copied into
+// the first pooled buffer nobody else holds, a new one only while all of them are in flight.
+// The last send queue lets go on the network thread: use_count() is a relaxed load, the fence
+// pairs it with the release of that decrement before the buffer is written again.
+t_frame_buffer FrameBuilder::finish() {
+  std::shared_ptr<std::vector<uint8_t>> frame;
+  for (const auto& pooled : this->pool) {
+    if (pooled.use_count() == 1) {
+      std::atomic_thread_fence(std::memory_order_acquire);
+      frame = pooled;
+      break;
+    }
+  }
+
+  if (!frame) {
+    frame = std::make_shared<std::vector<uint8_t>>();
+    if (this->pool.size() < FRAME_POOL_SIZE)
+      this->pool.push_back(frame);
+  }
+
+  uint32_t sizeNetwork = htonl(this->builder.GetSize());
+  const uint8_t* prefix = reinterpret_cast<const uint8_t*>(&sizeNetwork);
+  const uint8_t* payload = this->builder.GetBufferPointer();
+
+  frame->assign(prefix, prefix + sizeof(sizeNetwork));
+  frame->insert(frame->end(), payload, payload + this->builder.GetSize());
+  return frame;
+}
+
+// Once per tick. The builder lets go of its buffer before the arena takes it back.
+void FrameBuilder::rewind() {
+  this->builder.Reset();
+  this->arena.rewind();
+}
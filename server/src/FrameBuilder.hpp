@@ -0,0 +1,31 @@
+#ifndef FRAMEBUILDER_HPP
+#define FRAMEBUILDER_HPP
+
+#include "../includes/nibbler.hpp"
+#include "FrameArena.hpp"
+
+#define FRAME_BUILDER_INITIAL_SIZE 1024
+#define FRAME_POOL_SIZE 128 // covers the full-state frames pinned by the snapshot history
+
+// One FlatBufferBuilder for the whole run, backed by a FrameArena, and the pool of frame buffers
+// it finishes into. A pooled buffer is reused once no send queue holds it anymore.
+class FrameBuilder {
+public:
+  FrameBuilder();
+  FrameBuilder(const FrameBuilder& obj) = delete;
+  FrameBuilder& operator=(const FrameBuilder& obj) = delete;
+  FrameBuilder(FrameBuilder&& obj) = delete;
+  FrameBuilder& operator=(FrameBuilder&& obj) = delete;
+  ~FrameBuilder();
+
+  flatbuffers::FlatBufferBuilder& start(bool forceDefaults = false);
+  t_frame_buffer finish();
+  void rewind();
+
+private:
+  FrameArena arena;
+  flatbuffers::FlatBufferBuilder builder;
+  std::vector<std::shared_ptr<std::vector<uint8_t>>> pool;
+};
+
+#endif
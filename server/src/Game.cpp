@@ -1,38 +1,17 @@
 #include "Game.hpp"
 #include "Snake.hpp"
+#include <algorithm>
 #include <chrono>
-#include <fstream>
 
-#define MAX_FOOD_SPAWN_TRIES 50
 #define MAX_FOOD_COUNT 3
-
-bool hasInvalidChars(const std::string& line);
+#define SNAPSHOT_POOL_SIZE (SNAPSHOT_HISTORY + 4) // the server's history plus the ones in flight
 
 using Clock = std::chrono::steady_clock;
 
-Game::Game(int h, int w, const std::string& mapPath) : stopFlag(false) {
-  try {
-    if (mapPath.empty())
-      throw "Map is not defined";
-
-    loadGameMap(mapPath);
-  } catch (const char* err) {
-    std::cerr << err << ": fallback to an empty map" << std::endl;
-
-    writableField.clear();
-    for (int i = 0; i < h; i++)
-      writableField.push_back(std::string(w, FLOOR_TILE));
-  }
-
-  updateReadableField();
-  height.store(writableField.size());
-  width.store(writableField[0].size());
-
-  std::cout << "height: " << writableField.size() << ", width: " << writableField[0].size() << '\n';
-  printField();
-
-  srand(time(NULL)); // init random generator
-}
+// The walls come from the registry, the room only adds what moves on top of them
+Game::Game(std::shared_ptr<const t_map> map, uint32_t seed)
+    : map(map), field(std::shared_ptr<const Grid>(map, &map->walls)), playerCount(0), currentTick(0),
+      random(seed) {}
 
 Game::~Game() {
   std::cout << "Game destructor" << std::endl;
@@ -41,129 +20,241 @@ Game::~Game() {
     delete it->second;
 }
 
-void Game::stop() { stopFlag.store(true); }
+// One step of the room on the calling thread, RoomManager spreads the same stages over workers
+void Game::tick() {
+  proposeMoves(0, beginTick());
+  endTick();
+}
 
-void Game::loadGameMap(const std::string& mapFile) {
-  std::ifstream file(mapFile);
-  if (!file.is_open())
-    throw "Error opening map";
+// Stage one, returns how many snakes propose a move
+size_t Game::beginTick() {
+  applyCommands();
+  spawnSnakes();
 
-  int width = 0;
-  std::string line;
+  // a snake the full field had no cell for stays bodiless until a later tick spawns it
+  moves.snakes.clear();
+  for (const auto& snake : snakes) {
+    if (snake.second->getState() == State_Alive && !snake.second->getBody().empty())
+      moves.snakes.push_back(snake.second);
+  }
 
-  while (getline(file, line)) {
-    if (!width)
-      width = line.size();
+  // id order, so the outcome never depends on the hash map
+  std::sort(moves.snakes.begin(), moves.snakes.end(),
+            [](const Snake* a, const Snake* b) { return a->getId() < b->getId(); });
+
+  size_t count = moves.snakes.size();
+  moves.headX.resize(count);
+  moves.headY.resize(count);
+  moves.directions.resize(count);
+  moves.nextX.resize(count);
+  moves.nextY.resize(count);
+  moves.isBlocked.resize(count);
+  moves.outcomes.resize(count);
+  return count;
+}
 
-    if (hasInvalidChars(line)) {
-      file.close();
-      throw "Invalid characters";
-    }
+// Stage two, safe to run on disjoint slices from several threads: each slot only touches its own
+// snake and the field is not modified until endTick
+void Game::proposeMoves(size_t begin, size_t end) {
+  for (size_t i = begin; i < end; i++) {
+    Snake* snake = moves.snakes[i];
+    moves.directions[i] = snake->consumeDirection();
+    moves.headX[i] = snake->getHead().x;
+    moves.headY[i] = snake->getHead().y;
+  }
 
-    if ((int)line.size() != width) {
-      file.close();
-      throw "Invalid line width";
-    }
+  t_head_batch batch;
+  batch.headX = moves.headX.data() + begin;
+  batch.headY = moves.headY.data() + begin;
+  batch.directions = moves.directions.data() + begin;
+  batch.nextX = moves.nextX.data() + begin;
+  batch.nextY = moves.nextY.data() + begin;
+  batch.isBlocked = moves.isBlocked.data() + begin;
+  batch.count = end - begin;
+  batch.tiles = map->tiles.data();
+  batch.width = field.getWidth();
+  batch.height = field.getHeight();
+  advanceHeads(batch);
+}
 
-    writableField.push_back(line);
-  }
+// Stage three
+void Game::endTick() {
+  resolveMoves();
+  applyMoves();
+  spawnFood();
+  publishSnapshot();
+}
 
-  if (!file.eof()) {
-    file.close();
-    throw "Error reading assets file";
-  }
+void Game::spawnFood() {
+  int x;
+  int y;
+  if (food.size() >= MAX_FOOD_COUNT || !field.pickFreeCell(x, y, random))
+    return;
 
-  file.close();
+  field.setTile(x, y, FOOD_TILE);
+  food.emplace_back(std::make_pair(x, y));
 }
 
-void Game::start() {
-  auto nextMoveTime = Clock::now() + std::chrono::milliseconds(SNAKE_SPEED);
+// Joined since the last tick, in id order so the cells they get do not depend on the hash map
+void Game::spawnSnakes() {
+  moves.snakes.clear();
+  for (const auto& snake : snakes) {
+    if (snake.second->getBody().empty())
+      moves.snakes.push_back(snake.second);
+  }
 
-  while (!stopFlag.load()) {
-    auto now = Clock::now();
-    if (now >= nextMoveTime) {
-      moveSnakes();
-      spawnFood();
+  std::sort(moves.snakes.begin(), moves.snakes.end(),
+            [](const Snake* a, const Snake* b) { return a->getId() < b->getId(); });
 
-      updateReadableField();
-      setIsDataUpdated(true);
-      nextMoveTime = now + std::chrono::milliseconds(SNAKE_SPEED);
-    }
+  for (Snake* snake : moves.snakes)
+    snake->spawn(&field, random);
+}
 
-    std::this_thread::sleep_until(nextMoveTime);
+// Every proposal is judged against the field as it was before anyone moved, so the order snakes
+// are applied in changes nothing:
+// - off the field or into a wall dies
+// - two heads or more on the same cell all die, food there stays
+// - into a head or a body dies, a tail is only free when its snake moves on without eating
+// - onto food eats
+void Game::resolveMoves() {
+  size_t count = moves.snakes.size();
+
+  claims.clear();
+  for (size_t i = 0; i < count; i++) {
+    moves.outcomes[i] = moves.isBlocked[i] ? OUTCOME_DIES : OUTCOME_MOVES;
+    if (!moves.isBlocked[i])
+      claims.emplace_back((uint32_t)moves.nextY[i] * field.getWidth() + moves.nextX[i], i);
   }
-}
 
-void Game::spawnFood() {
-  std::lock_guard<std::mutex> lock(foodMutex);
+  std::sort(claims.begin(), claims.end());
+  for (size_t k = 0; k < claims.size();) {
+    size_t run = k + 1;
+    while (run < claims.size() && claims[run].first == claims[k].first)
+      run++;
 
-  if (food.size() >= MAX_FOOD_COUNT)
-    return;
+    if (run - k > 1) {
+      for (size_t j = k; j < run; j++)
+        moves.outcomes[claims[j].second] = OUTCOME_DIES;
+    }
+    k = run;
+  }
 
-  for (int i = 0; i < MAX_FOOD_SPAWN_TRIES; i++) {
-    int r1 = rand();
-    int r2 = rand();
-    int x = r1 % (width - 1);
-    int y = r2 % (height - 1);
+  // food first, whether a tail moves on depends on its snake eating
+  for (size_t i = 0; i < count; i++) {
+    if (moves.outcomes[i] == OUTCOME_MOVES && field.getTile(moves.nextX[i], moves.nextY[i]) == FOOD_TILE)
+      moves.outcomes[i] = OUTCOME_EATS;
+  }
 
-    if (writableField[y][x] == FLOOR_TILE) {
-      writableField[y][x] = FOOD_TILE;
-      food.emplace_back(std::make_pair(x, y));
-      return;
+  for (size_t i = 0; i < count; i++) {
+    if (moves.outcomes[i] != OUTCOME_MOVES)
+      continue;
+
+    char tile = field.getTile(moves.nextX[i], moves.nextY[i]);
+    if (tile == BODY_TILE || tile == HEAD_TILE)
+      moves.outcomes[i] = OUTCOME_DIES;
+    else if (tile == TAIL_TILE) {
+      size_t owner = findSlot(field.getOwner(moves.nextX[i], moves.nextY[i]));
+      bool isVacating =
+          owner != count && moves.snakes[owner]->isTailVacating(moves.outcomes[owner] == OUTCOME_EATS);
+      if (!isVacating)
+        moves.outcomes[i] = OUTCOME_DIES;
     }
   }
 }
 
-void Game::moveSnakes() {
-  std::lock_guard<std::mutex> lock(snakesMutex);
+// In id order, the dead are cleared off the field after the survivors moved
+void Game::applyMoves() {
+  for (size_t i = 0; i < moves.snakes.size(); i++) {
+    if (moves.outcomes[i] == OUTCOME_DIES) {
+      moves.snakes[i]->kill();
+      continue;
+    }
+
+    bool eats = moves.outcomes[i] == OUTCOME_EATS;
+    moves.snakes[i]->advance(&field, {moves.nextX[i], moves.nextY[i]}, eats);
+    if (eats)
+      removeFood(moves.nextX[i], moves.nextY[i]);
+  }
 
-  for (auto it = snakes.begin(); it != snakes.end();) {
-    it->second->moveSnake(&writableField);
+  for (size_t i = 0; i < moves.snakes.size(); i++) {
+    if (moves.outcomes[i] != OUTCOME_DIES)
+      continue;
 
-    if (it->second->getState() == State_Dead) {
-      it->second->cleanup(&writableField);
-      delete it->second;
-      it = snakes.erase(it);
-    } else
-      ++it;
+    Snake* snake = moves.snakes[i];
+    snake->cleanup(&field);
+    snakes.erase(snake->getId());
+    delete snake;
   }
 }
 
-void Game::addSnake(int clientFd) {
-  std::lock_guard<std::mutex> lock1(snakesMutex);
+// Slot of the alive snake with this id, the snake count when it does not move this tick
+size_t Game::findSlot(int id) const {
+  auto slot = std::lower_bound(moves.snakes.begin(), moves.snakes.end(), id,
+                               [](const Snake* snake, int id) { return snake->getId() < id; });
+  if (slot == moves.snakes.end() || (*slot)->getId() != id)
+    return moves.snakes.size();
+  return slot - moves.snakes.begin();
+}
 
-  Snake* newSnake = new Snake(this);
-  snakes[clientFd] = newSnake;
+void Game::addSnake(int clientFd, int length) {
+  playerCount.fetch_add(1);
+  pushCommand({COMMAND_JOIN, clientFd, length});
 }
 
 void Game::removeSnake(int fd) {
-  std::lock_guard<std::mutex> lock(snakesMutex);
-
-  auto snake = snakes.find(fd);
-  if (snake != snakes.end() && snake->second) {
-    snake->second->cleanup(&writableField);
-    delete snake->second;
-    snakes.erase(snake);
-  }
+  playerCount.fetch_sub(1);
+  pushCommand({COMMAND_LEAVE, fd, 0});
 }
 
-void Game::updateReadableField() {
-  std::lock_guard<std::mutex> lock(readableFieldMutex);
+void Game::updateSnakeDirection(int fd, int dir) { pushCommand({COMMAND_DIRECTION, fd, dir}); }
 
-  readableField = writableField;
+// Network thread. Joins and leaves are never lost, a direction is dropped when the ring is full.
+void Game::pushCommand(const t_command& command) {
+  flushCommands();
+
+  if (!overflowCommands.empty() || !commands.push(command)) {
+    if (command.type != COMMAND_DIRECTION)
+      overflowCommands.push_back(command);
+  }
 }
 
-void Game::updateSnakeDirection(int fd, int dir) {
-  std::lock_guard<std::mutex> lock(snakesMutex);
+// Network thread, retries what the ring had no room for, in order
+void Game::flushCommands() {
+  while (!overflowCommands.empty() && commands.push(overflowCommands.front()))
+    overflowCommands.pop_front();
+}
 
-  auto it = snakes.find(fd);
-  if (it != snakes.end() && it->second)
-    snakes[fd]->setDirection(dir);
+// Ticking worker, the only place snakes are created, steered or removed. What it pops is kept for
+// the replay log, the room's state is a function of its seed and these alone.
+void Game::applyCommands() {
+  t_command command;
+
+  tickInputs.clear();
+  while (commands.pop(command)) {
+    tickInputs.push_back(command);
+    auto it = snakes.find(command.id);
+
+    switch (command.type) {
+    case COMMAND_JOIN:
+      if (it == snakes.end())
+        snakes[command.id] = new Snake(command.id, std::max(command.value, 1));
+      break;
+    case COMMAND_LEAVE:
+      if (it != snakes.end()) {
+        it->second->cleanup(&field);
+        delete it->second;
+        snakes.erase(it);
+      }
+      break;
+    case COMMAND_DIRECTION:
+      if (it != snakes.end())
+        it->second->setDirection(command.value);
+      break;
+    }
+  }
 }
 
 void Game::removeFood(int x, int y) {
-  std::lock_guard<std::mutex> lock(foodMutex);
-
   for (auto it = food.begin(); it != food.end(); ++it) {
     if (it->first == x && it->second == y) {
       food.erase(it);
@@ -172,67 +263,62 @@ void Game::removeFood(int x, int y) {
   }
 }
 
-flatbuffers::Offset<Packet> Game::serializeGameData(flatbuffers::FlatBufferBuilder& builder) {
-  std::lock_guard<std::mutex> lock(snakesMutex);
-
-  std::vector<flatbuffers::Offset<SnakeObj>> snakesVec;
-  snakesVec.reserve(snakes.size());
-
-  for (auto snake : snakes) {
-    std::vector<Pos> bodyVec;
-    for (auto pos : snake.second->getBody())
-      bodyVec.emplace_back(Pos(pos.x, pos.y));
-
-    int id = snake.first;
-    int score = snake.second->getScore();
-    auto state = snake.second->getState();
-    auto body = builder.CreateVectorOfStructs(bodyVec);
-    auto snakeObject = CreateSnakeObj(builder, id, score, state, body);
-    snakesVec.emplace_back(snakeObject);
+// Snakes sorted by id so snapshots can be diffed. The full state is serialized here once for
+// every client, the server only builds the deltas. A pooled snapshot is let go by the network
+// thread, the fence orders its reuse after that release as use_count() alone does not.
+void Game::publishSnapshot() {
+  std::shared_ptr<t_snapshot> snapshot;
+  for (const auto& pooled : snapshotPool) {
+    if (pooled.use_count() == 1) {
+      std::atomic_thread_fence(std::memory_order_acquire);
+      snapshot = pooled;
+      break;
+    }
   }
 
-  std::vector<Pos> foodVec;
-  foodVec.reserve(food.size());
-
-  for (auto f : food) {
-    foodVec.emplace_back(Pos(f.first, f.second));
+  if (!snapshot) {
+    snapshot = std::make_shared<t_snapshot>();
+    if (snapshotPool.size() < SNAPSHOT_POOL_SIZE)
+      snapshotPool.push_back(snapshot);
   }
 
-  auto snakesData = builder.CreateVector(snakesVec);
-  auto foodData = builder.CreateVectorOfStructs(foodVec);
-  auto gameData = CreateGameData(builder, snakesData, foodData);
-  return CreatePacket(builder, MsgType_Game, MsgUnion_GameData, gameData.Union());
-}
-
-flatbuffers::Offset<Packet> Game::serializeMapData(flatbuffers::FlatBufferBuilder& builder, int fd) {
-  std::lock_guard<std::mutex> lock(readableFieldMutex);
-
-  std::vector<flatbuffers::Offset<Row>> rows;
-  rows.reserve(readableField.size());
+  snapshot->tick = ++currentTick;
+  snapshot->simulatedAt =
+      std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now().time_since_epoch()).count();
+
+  // a recycled snapshot keeps the capacity of its vectors
+  snapshot->snakes.resize(snakes.size());
+  auto state = snapshot->snakes.begin();
+  for (const auto& snake : snakes) {
+    state->id = snake.first;
+    state->score = snake.second->getScore();
+    state->state = snake.second->getState();
+
+    const SnakeBody& body = snake.second->getBody();
+    state->body.assign(body.begin(), body.end());
+    ++state;
+  }
 
-  for (auto row : readableField) {
-    std::vector<int8_t> tiles;
-    tiles.reserve(row.size());
+  std::sort(snapshot->snakes.begin(), snapshot->snakes.end(),
+            [](const t_snake_state& a, const t_snake_state& b) { return a.id < b.id; });
 
-    for (char tile : row) {
-      if (tile == WALL_HORIZ_TILE)
-        tiles.emplace_back(Tile_WallHorizontal);
-      else if (tile == WALL_VERTI_TILE)
-        tiles.emplace_back(Tile_WallVertical);
-      else
-        tiles.emplace_back(Tile_Empty);
-    }
+  snapshot->food.resize(food.size());
+  for (size_t i = 0; i < food.size(); i++)
+    snapshot->food[i] = {food[i].first, food[i].second};
 
-    auto tilesData = builder.CreateVector(tiles);
-    rows.emplace_back(CreateRow(builder, tilesData));
+  frameBuilder.rewind();
+  for (size_t encoding = 0; encoding < SNAPSHOT_ENCODINGS; encoding++) {
+    flatbuffers::FlatBufferBuilder& builder = frameBuilder.start();
+    builder.Finish(serializeSnapshot(builder, serializeScratch, *snapshot, encoding));
+    snapshot->frames[encoding] = frameBuilder.finish();
   }
 
-  auto map = builder.CreateVector(rows);
-  auto mapData = CreateMapData(builder, map, fd);
-  return CreatePacket(builder, MsgType_Map, MsgUnion_MapData, mapData.Union());
+  std::atomic_store(&publishedSnapshot, std::shared_ptr<const t_snapshot>(snapshot));
 }
 
-void Game::setIsDataUpdated(bool value) { isDataUpdated.store(value); }
+std::shared_ptr<const t_snapshot> Game::getPublishedSnapshot() const {
+  return std::atomic_load(&publishedSnapshot);
+}
 
 State Game::getSnakeState(const int fd) {
   auto it = snakes.find(fd);
@@ -242,27 +328,15 @@ State Game::getSnakeState(const int fd) {
   return State_Dead;
 }
 
-int Game::getHeight() const { return height.load(); }
+int Game::getHeight() const { return field.getHeight(); }
 
-int Game::getWidth() const { return width.load(); }
+int Game::getWidth() const { return field.getWidth(); }
 
-bool Game::getStopFlag() const { return stopFlag.load(); }
+int Game::getPlayerCount() const { return playerCount.load(); }
 
-bool Game::getIsDataUpdated() const { return isDataUpdated.load(); }
+// Nobody joined and the last leave is applied, ticking would only move the food around
+bool Game::isIdle() const { return !playerCount.load() && snakes.empty(); }
 
-void Game::printField() {
-  std::lock_guard<std::mutex> lock(readableFieldMutex);
+const t_map& Game::getMap() const { return *map; }
 
-  std::cout << "\n\n";
-  for (size_t i = 0; i < readableField.size(); i++)
-    printf("%3zu:%s\n", i, readableField[i].c_str());
-  std::cout << "\n\n";
-}
-
-bool hasInvalidChars(const std::string& line) {
-  for (char c : line) {
-    if (c != FLOOR_TILE && c != WALL_HORIZ_TILE && c != WALL_VERTI_TILE)
-      return true;
-  }
-  return false;
-}
+const std::vector<t_command>& Game::getTickInputs() const { return tickInputs; }
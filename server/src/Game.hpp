@@ -2,61 +2,97 @@
 #define GAME_HPP
 
 #include "../includes/nibbler.hpp"
+#include "CommandQueue.hpp"
+#include "Field.hpp"
+#include "FrameBuilder.hpp"
+#include "MapRegistry.hpp"
+#include "Snapshot.hpp"
+#include <deque>
 
 using xCoord = int;
 using yCoord = int;
 
 class Snake;
 
+enum e_outcome { OUTCOME_MOVES, OUTCOME_EATS, OUTCOME_DIES };
+
+// The alive snakes of a tick in id order, slot i of every array belongs to the same snake.
+// Proposals are written by slice from several workers, the resolver reads them all.
+typedef struct s_moves {
+  std::vector<Snake*> snakes;
+  std::vector<int> headX;
+  std::vector<int> headY;
+  std::vector<int> directions; // e_direction
+  std::vector<int> nextX;      // proposed head
+  std::vector<int> nextY;
+  std::vector<uint8_t> isBlocked; // proposed head off the field or on a wall
+  std::vector<uint8_t> outcomes;  // e_outcome, filled by the resolver
+} t_moves;
+
 class Game {
 public:
-  Game(int height, int width, const std::string& mapPath);
+  Game(std::shared_ptr<const t_map> map, uint32_t seed);
   Game(const Game& obj) = delete;
   Game& operator=(const Game& obj) = delete;
   Game(Game&& obj) = delete;
   Game& operator=(Game&& obj) = delete;
   ~Game();
 
-  void start();
-  void stop();
+  void tick();
+  size_t beginTick();
+  void proposeMoves(size_t begin, size_t end);
+  void endTick();
 
-  void removeFood(int x, int y);
-  void addSnake(int fd);
+  void addSnake(int fd, int length = SNAKE_INITIAL_LENGTH);
   void removeSnake(int fd);
   void updateSnakeDirection(int fd, int dir);
-  void setIsDataUpdated(bool value);
+  void flushCommands();
 
   int getHeight() const;
   int getWidth() const;
-  bool getStopFlag() const;
-  bool getIsDataUpdated() const;
-  flatbuffers::Offset<Packet> serializeGameData(flatbuffers::FlatBufferBuilder& builder);
-  flatbuffers::Offset<Packet> serializeMapData(flatbuffers::FlatBufferBuilder& builder, int fd);
+  int getPlayerCount() const;
+  bool isIdle() const;
+  const t_map& getMap() const;
+  const std::vector<t_command>& getTickInputs() const;
+  std::shared_ptr<const t_snapshot> getPublishedSnapshot() const;
 
 private:
-  std::vector<std::string> writableField;
+  std::shared_ptr<const t_map> map; // shared with every room on the same map
+  Field field;
 
   // Used by another thread
-  std::atomic<int> height;
-  std::atomic<int> width;
-  std::atomic<bool> stopFlag;
-  std::atomic<bool> isDataUpdated;
+  std::atomic<int> playerCount; // joined minus left, counted by the network thread for matchmaking
 
-  std::mutex snakesMutex;
-  std::unordered_map<int, Snake*> snakes;
+  // Joins, leaves and directions from the network thread, applied at the start of a tick
+  CommandQueue commands;
+  std::deque<t_command> overflowCommands; // network thread only, joins and leaves left over
 
-  std::mutex foodMutex;
+  // Ticking worker only, the network thread sees them through the published snapshots
+  std::unordered_map<int, Snake*> snakes;
   std::vector<std::pair<xCoord, yCoord>> food;
+  uint32_t currentTick;
+  std::mt19937 random; // every draw of the room, so a seed and its inputs replay it exactly
+  std::vector<t_command> tickInputs; // the commands applied this tick, in the order they were
+  t_moves moves;
+  std::vector<std::pair<uint32_t, uint32_t>> claims; // (cell, slot) of every proposed head
 
-  std::mutex readableFieldMutex;
-  std::vector<std::string> readableField;
+  // Serialized at the end of every tick and swapped in atomically. A pooled snapshot is reused
+  // once the server's history let go of it.
+  std::shared_ptr<const t_snapshot> publishedSnapshot;
+  std::vector<std::shared_ptr<t_snapshot>> snapshotPool;
+  FrameBuilder frameBuilder;
+  t_serialize_scratch serializeScratch;
 
+  void pushCommand(const t_command& command);
+  void applyCommands();
   void spawnFood();
-  void moveSnakes();
-  void updateReadableField();
-  void printField();
+  void removeFood(int x, int y);
+  void spawnSnakes();
+  void resolveMoves();
+  void applyMoves();
+  size_t findSlot(int id) const;
+  void publishSnapshot();
   State getSnakeState(const int fd);
-  void loadGameMap(const std::string& mapFile);
 };
 
 #endif
@@ -0,0 +1,70 @@
+#include "Grid.hpp"
+
+Grid::Grid() : width(0), height(0) {}
+
+Grid::~Grid() {}
+
+void Grid::reset(int width, int height, char tile) {
+  this->width = width;
+  this->height = height;
+  this->cells.assign((size_t)width * height, {tile, NO_OWNER});
+
+  this->freeCells.clear();
+  this->freeSlots.assign(this->cells.size(), NOT_FREE);
+  if (tile == FLOOR_TILE) {
+    for (uint32_t i = 0; i < this->cells.size(); i++)
+      addFree(i);
+  }
+}
+
+void Grid::setTile(int x, int y, char tile, int owner) {
+  uint32_t i = index(x, y);
+  bool wasFree = this->cells[i].tile == FLOOR_TILE;
+
+  this->cells[i] = {tile, owner};
+
+  if (wasFree && tile != FLOOR_TILE)
+    removeFree(i);
+  else if (!wasFree && tile == FLOOR_TILE)
+    addFree(i);
+}
+
+// Uniform over every floor cell, fails only when there is none left. A plain modulo rather than a
+// distribution, whose output differs between standard libraries and would break replays.
+bool Grid::pickFreeCell(int& x, int& y, std::mt19937& random) const {
+  if (this->freeCells.empty())
+    return false;
+
+  uint32_t i = this->freeCells[random() % this->freeCells.size()];
+  x = i % this->width;
+  y = i / this->width;
+  return true;
+}
+
+void Grid::addFree(uint32_t i) {
+  this->freeSlots[i] = this->freeCells.size();
+  this->freeCells.push_back(i);
+}
+
+// swaps the last free cell into the hole
+void Grid::removeFree(uint32_t i) {
+  uint32_t slot = this->freeSlots[i];
+  uint32_t last = this->freeCells.back();
+
+  this->freeCells[slot] = last;
+  this->freeSlots[last] = slot;
+  this->freeCells.pop_back();
+  this->freeSlots[i] = NOT_FREE;
+}
+
+void Grid::setRow(int y, const std::string& row) {
+  for (int x = 0; x < this->width && x < (int)row.size(); x++)
+    setTile(x, y, row[x]);
+}
+
+std::string Grid::getRow(int y) const {
+  std::string row(this->width, FLOOR_TILE);
+  for (int x = 0; x < this->width; x++)
+    row[x] = getTile(x, y);
+  return row;
+}
@@ -0,0 +1,59 @@
+#ifndef GRID_HPP
+#define GRID_HPP
+
+#include "../includes/nibbler.hpp"
+
+#define NO_OWNER -1
+#define NOT_FREE UINT32_MAX
+
+typedef struct s_cell {
+  char tile; // one of the *_TILE characters
+  int owner; // id of the snake on this cell, NO_OWNER otherwise
+} t_cell;
+
+// Game field in one row-major buffer, a cell is found by linear index. Copyable so a whole
+// field can be snapshotted, hashed or compared in a single pass. Floor cells are also kept in
+// a swap-remove index, so a random free cell is found in O(1).
+class Grid {
+public:
+  Grid();
+  Grid(const Grid& obj) = default;
+  Grid& operator=(const Grid& obj) = default;
+  Grid(Grid&& obj) = default;
+  Grid& operator=(Grid&& obj) = default;
+  ~Grid();
+
+  void reset(int width, int height, char tile);
+  void setRow(int y, const std::string& row);
+  std::string getRow(int y) const;
+  bool pickFreeCell(int& x, int& y, std::mt19937& random) const;
+  size_t getFreeCount() const { return this->freeCells.size(); }
+  uint32_t getFreeCell(size_t slot) const { return this->freeCells[slot]; }
+  uint32_t getFreeSlot(size_t i) const { return this->freeSlots[i]; }
+
+  int getWidth() const { return this->width; }
+  int getHeight() const { return this->height; }
+  size_t getSize() const { return this->cells.size(); }
+  bool isInside(int x, int y) const { return x >= 0 && y >= 0 && x < this->width && y < this->height; }
+  bool isFree(int x, int y) const { return isInside(x, y) && getTile(x, y) == FLOOR_TILE; }
+  size_t index(int x, int y) const { return (size_t)y * this->width + x; }
+
+  const t_cell& at(int x, int y) const { return this->cells[index(x, y)]; }
+  const t_cell& operator[](size_t i) const { return this->cells[i]; }
+
+  char getTile(int x, int y) const { return at(x, y).tile; }
+  int getOwner(int x, int y) const { return at(x, y).owner; }
+  void setTile(int x, int y, char tile, int owner = NO_OWNER);
+
+private:
+  int width;
+  int height;
+  std::vector<t_cell> cells;
+  std::vector<uint32_t> freeCells; // indices of floor cells, in no particular order
+  std::vector<uint32_t> freeSlots; // position of each cell in freeCells, NOT_FREE otherwise
+
+  void addFree(uint32_t i);
+  void removeFree(uint32_t i);
+};
+
+#endif
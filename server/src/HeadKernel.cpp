@@ -0,0 +1,152 @@
+#include "HeadKernel.hpp"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define HAS_X86_KERNELS
+#include <immintrin.h>
+#endif
+
+static inline void advanceHead(const t_head_batch& batch, size_t i) {
+  int direction = batch.directions[i];
+  int x = batch.headX[i] + (direction == RIGHT) - (direction == LEFT);
+  int y = batch.headY[i] + (direction == DOWN) - (direction == UP);
+  batch.nextX[i] = x;
+  batch.nextY[i] = y;
+
+  bool isInside = x >= 0 && y >= 0 && x < batch.width && y < batch.height;
+  char tile = isInside ? batch.tiles[(size_t)y * batch.width + x] : WALL_HORIZ_TILE;
+  batch.isBlocked[i] = tile == WALL_HORIZ_TILE || tile == WALL_VERTI_TILE;
+}
+
+static void advanceHeadsScalar(const t_head_batch& batch) {
+  for (size_t i = 0; i < batch.count; i++)
+    advanceHead(batch, i);
+}
+
+#ifdef HAS_X86_KERNELS
+
+// Four lanes, SSE has no gather so the tiles are loaded one by one from the computed indices
+__attribute__((target("sse4.2"))) static void advanceHeadsSse42(const t_head_batch& batch) {
+  const __m128i up = _mm_set1_epi32(UP);
+  const __m128i down = _mm_set1_epi32(DOWN);
+  const __m128i left = _mm_set1_epi32(LEFT);
+  const __m128i right = _mm_set1_epi32(RIGHT);
+  const __m128i width = _mm_set1_epi32(batch.width);
+  const __m128i height = _mm_set1_epi32(batch.height);
+  const __m128i minusOne = _mm_set1_epi32(-1);
+  const __m128i wallHorizontal = _mm_set1_epi32(WALL_HORIZ_TILE);
+  const __m128i wallVertical = _mm_set1_epi32(WALL_VERTI_TILE);
+
+  size_t i = 0;
+  for (; i + 4 <= batch.count; i += 4) {
+    __m128i direction = _mm_loadu_si128((const __m128i*)(batch.directions + i));
+    __m128i x = _mm_loadu_si128((const __m128i*)(batch.headX + i));
+    __m128i y = _mm_loadu_si128((const __m128i*)(batch.headY + i));
+
+    // a true compare is -1, so left minus right is the x step
+    x = _mm_add_epi32(x,
+                      _mm_sub_epi32(_mm_cmpeq_epi32(direction, left), _mm_cmpeq_epi32(direction, right)));
+    y = _mm_add_epi32(y, _mm_sub_epi32(_mm_cmpeq_epi32(direction, up), _mm_cmpeq_epi32(direction, down)));
+    _mm_storeu_si128((__m128i*)(batch.nextX + i), x);
+    _mm_storeu_si128((__m128i*)(batch.nextY + i), y);
+
+    __m128i isInside = _mm_and_si128(_mm_and_si128(_mm_cmpgt_epi32(x, minusOne), _mm_cmpgt_epi32(width, x)),
+                                     _mm_and_si128(_mm_cmpgt_epi32(y, minusOne), _mm_cmpgt_epi32(height, y)));
+    __m128i index = _mm_and_si128(_mm_add_epi32(_mm_mullo_epi32(y, width), x), isInside);
+
+    __m128i tile =
+        _mm_setr_epi32(batch.tiles[_mm_extract_epi32(index, 0)], batch.tiles[_mm_extract_epi32(index, 1)],
+                       batch.tiles[_mm_extract_epi32(index, 2)], batch.tiles[_mm_extract_epi32(index, 3)]);
+    __m128i isBlocked = _mm_or_si128(_mm_andnot_si128(isInside, minusOne),
+                                     _mm_or_si128(_mm_cmpeq_epi32(tile, wallHorizontal),
+                                                  _mm_cmpeq_epi32(tile, wallVertical)));
+
+    int lanes = _mm_movemask_ps(_mm_castsi128_ps(isBlocked));
+    for (int lane = 0; lane < 4; lane++)
+      batch.isBlocked[i + lane] = (lanes >> lane) & 1;
+  }
+
+  for (; i < batch.count; i++)
+    advanceHead(batch, i);
+}
+
+// Eight lanes, the tiles of all eight heads come in one gather
+__attribute__((target("avx2"))) static void advanceHeadsAvx2(const t_head_batch& batch) {
+  const __m256i up = _mm256_set1_epi32(UP);
+  const __m256i down = _mm256_set1_epi32(DOWN);
+  const __m256i left = _mm256_set1_epi32(LEFT);
+  const __m256i right = _mm256_set1_epi32(RIGHT);
+  const __m256i width = _mm256_set1_epi32(batch.width);
+  const __m256i height = _mm256_set1_epi32(batch.height);
+  const __m256i minusOne = _mm256_set1_epi32(-1);
+  const __m256i byteMask = _mm256_set1_epi32(0xFF);
+  const __m256i wallHorizontal = _mm256_set1_epi32(WALL_HORIZ_TILE);
+  const __m256i wallVertical = _mm256_set1_epi32(WALL_VERTI_TILE);
+
+  size_t i = 0;
+  for (; i + 8 <= batch.count; i += 8) {
+    __m256i direction = _mm256_loadu_si256((const __m256i*)(batch.directions + i));
+    __m256i x = _mm256_loadu_si256((const __m256i*)(batch.headX + i));
+    __m256i y = _mm256_loadu_si256((const __m256i*)(batch.headY + i));
+
+    x = _mm256_add_epi32(
+        x, _mm256_sub_epi32(_mm256_cmpeq_epi32(direction, left), _mm256_cmpeq_epi32(direction, right)));
+    y = _mm256_add_epi32(
+        y, _mm256_sub_epi32(_mm256_cmpeq_epi32(direction, up), _mm256_cmpeq_epi32(direction, down)));
+    _mm256_storeu_si256((__m256i*)(batch.nextX + i), x);
+    _mm256_storeu_si256((__m256i*)(batch.nextY + i), y);
+
+    __m256i isInside =
+        _mm256_and_si256(_mm256_and_si256(_mm256_cmpgt_epi32(x, minusOne), _mm256_cmpgt_epi32(width, x)),
+                         _mm256_and_si256(_mm256_cmpgt_epi32(y, minusOne), _mm256_cmpgt_epi32(height, y)));
+    // lanes off the field read cell 0, they are blocked whatever it holds
+    __m256i index = _mm256_and_si256(_mm256_add_epi32(_mm256_mullo_epi32(y, width), x), isInside);
+
+    // four bytes per lane starting at the tile, only the first one is kept
+    __m256i tile = _mm256_and_si256(_mm256_i32gather_epi32((const int*)batch.tiles, index, 1), byteMask);
+    __m256i isWall =
+        _mm256_or_si256(_mm256_cmpeq_epi32(tile, wallHorizontal), _mm256_cmpeq_epi32(tile, wallVertical));
+    __m256i isBlocked = _mm256_or_si256(_mm256_andnot_si256(isInside, minusOne), isWall);
+
+    int lanes = _mm256_movemask_ps(_mm256_castsi256_ps(isBlocked));
+    for (int lane = 0; lane < 8; lane++)
+      batch.isBlocked[i + lane] = (lanes >> lane) & 1;
+  }
+
+  for (; i < batch.count; i++)
+    advanceHead(batch, i);
+}
+
+#endif
+
+t_head_kernel getHeadKernel(enum e_head_kernel kind) {
+  switch (kind) {
+  case HEAD_KERNEL_SCALAR:
+    return advanceHeadsScalar;
+#ifdef HAS_X86_KERNELS
+  case HEAD_KERNEL_SSE42:
+    return __builtin_cpu_supports("sse4.2") ? advanceHeadsSse42 : nullptr;
+  case HEAD_KERNEL_AVX2:
+    return __builtin_cpu_supports("avx2") ? advanceHeadsAvx2 : nullptr;
+#endif
+  default:
+    return nullptr;
+  }
+}
+
+const char* getHeadKernelName(enum e_head_kernel kind) {
+  static const char* names[HEAD_KERNEL_COUNT] = {"scalar", "sse4.2", "avx2"};
+  return names[kind];
+}
+
+static t_head_kernel selectHeadKernel() {
+  for (int kind = HEAD_KERNEL_COUNT - 1; kind > HEAD_KERNEL_SCALAR; kind--) {
+    if (t_head_kernel kernel = getHeadKernel((enum e_head_kernel)kind))
+      return kernel;
+  }
+  return advanceHeadsScalar;
+}
+
+void advanceHeads(const t_head_batch& batch) {
+  static const t_head_kernel kernel = selectHeadKernel();
+  kernel(batch);
+}
@@ -0,0 +1,34 @@
+#ifndef HEAD_KERNEL_HPP
+#define HEAD_KERNEL_HPP
+
+#include "../includes/nibbler.hpp"
+
+#define HEAD_KERNEL_PADDING 3 // tiles may be gathered 4 bytes at a time from the last cell
+
+enum e_head_kernel { HEAD_KERNEL_SCALAR, HEAD_KERNEL_SSE42, HEAD_KERNEL_AVX2, HEAD_KERNEL_COUNT };
+
+// count heads in structure-of-arrays form, each moved one cell in its direction. A proposed head
+// off the field or on a wall tile comes out blocked.
+typedef struct s_head_batch {
+  const int* headX;
+  const int* headY;
+  const int* directions; // e_direction
+  int* nextX;
+  int* nextY;
+  uint8_t* isBlocked;
+  size_t count;
+  const char* tiles; // row-major wall layer, HEAD_KERNEL_PADDING readable bytes past the end
+  int width;
+  int height;
+} t_head_batch;
+
+typedef void (*t_head_kernel)(const t_head_batch& batch);
+
+// The widest kernel the CPU runs, picked on first use
+void advanceHeads(const t_head_batch& batch);
+
+// nullptr when the CPU or the build does not have it
+t_head_kernel getHeadKernel(enum e_head_kernel kind);
+const char* getHeadKernelName(enum e_head_kernel kind);
+
+#endif
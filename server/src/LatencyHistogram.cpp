@@ -0,0 +1,75 @@
+#include "LatencyHistogram.hpp"
+#include <algorithm>
+#include <iomanip>
+
+#define HISTOGRAM_BAR_WIDTH 40
+
+LatencyHistogram::LatencyHistogram(const std::string& name)
+    : name(name), buckets{}, count(0), totalNanos(0), maxNanos(0) {}
+
+LatencyHistogram::~LatencyHistogram() {}
+
+static int bucketIndex(int64_t micros) {
+  int index = 0;
+  while (micros > 0 && index < HISTOGRAM_BUCKETS - 1) {
+    micros >>= 1;
+    index++;
+  }
+  return index;
+}
+
+static int64_t bucketUpperBound(int index) { return (int64_t)1 << index; }
+
+void LatencyHistogram::record(int64_t nanoseconds) {
+  if (nanoseconds < 0)
+    nanoseconds = 0;
+
+  this->buckets[bucketIndex(nanoseconds / 1000)]++;
+  this->count++;
+  this->totalNanos += nanoseconds;
+  this->maxNanos = std::max(this->maxNanos, nanoseconds);
+}
+
+// upper bound of the bucket holding the given percentile
+int64_t LatencyHistogram::getPercentileMicros(double percentile) const {
+  if (!this->count)
+    return 0;
+
+  uint64_t rank = (uint64_t)(percentile / 100.0 * (this->count - 1)) + 1;
+  uint64_t seen = 0;
+  for (int i = 0; i < HISTOGRAM_BUCKETS; i++) {
+    seen += this->buckets[i];
+    if (seen >= rank)
+      return bucketUpperBound(i);
+  }
+  return bucketUpperBound(HISTOGRAM_BUCKETS - 1);
+}
+
+void LatencyHistogram::print(std::ostream& out) const {
+  out << this->name << ": " << this->count << " samples";
+  if (!this->count) {
+    out << std::endl;
+    return;
+  }
+
+  out << ", avg " << this->totalNanos / this->count / 1000 << "us, p50 <" << getPercentileMicros(50)
+      << "us, p99 <" << getPercentileMicros(99) << "us, max " << this->maxNanos / 1000 << "us" << std::endl;
+
+  uint64_t peak = *std::max_element(this->buckets, this->buckets + HISTOGRAM_BUCKETS);
+  for (int i = 0; i < HISTOGRAM_BUCKETS; i++) {
+    if (!this->buckets[i])
+      continue;
+
+    char label[32];
+    if (i == HISTOGRAM_BUCKETS - 1)
+      snprintf(label, sizeof(label), ">= %lldus", (long long)bucketUpperBound(i - 1));
+    else
+      snprintf(label, sizeof(label), "< %lldus", (long long)bucketUpperBound(i));
+
+    int width = (int)(this->buckets[i] * HISTOGRAM_BAR_WIDTH / peak);
+    out << std::setw(12) << label << " | " << std::string(std::max(width, 1), '#') << " " << this->buckets[i]
+        << std::endl;
+  }
+}
+
+uint64_t LatencyHistogram::getCount() const { return this->count; }
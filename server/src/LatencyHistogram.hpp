@@ -0,0 +1,32 @@
+#ifndef LATENCYHISTOGRAM_HPP
+#define LATENCYHISTOGRAM_HPP
+
+#include "../includes/nibbler.hpp"
+
+// bucket i counts samples in [2^(i-1), 2^i) microseconds, the last one is open-ended
+#define HISTOGRAM_BUCKETS 24
+
+class LatencyHistogram {
+public:
+  LatencyHistogram(const std::string& name);
+  LatencyHistogram(const LatencyHistogram& obj) = delete;
+  LatencyHistogram& operator=(const LatencyHistogram& obj) = delete;
+  LatencyHistogram(LatencyHistogram&& obj) = delete;
+  LatencyHistogram& operator=(LatencyHistogram&& obj) = delete;
+  ~LatencyHistogram();
+
+  void record(int64_t nanoseconds);
+  void print(std::ostream& out) const;
+
+  uint64_t getCount() const;
+  int64_t getPercentileMicros(double percentile) const;
+
+private:
+  std::string name;
+  uint64_t buckets[HISTOGRAM_BUCKETS];
+  uint64_t count;
+  int64_t totalNanos;
+  int64_t maxNanos;
+};
+
+#endif
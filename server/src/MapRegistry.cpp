@@ -0,0 +1,152 @@
+#include "MapRegistry.hpp"
+#include "FrameBuilder.hpp"
+#include <fstream>
+#include <iomanip>
+
+bool hasInvalidChars(const std::string& line);
+
+MapRegistry::MapRegistry() {}
+
+MapRegistry::~MapRegistry() {}
+
+// Falls back to an empty height x width map when the file cannot be used
+std::shared_ptr<const t_map> MapRegistry::load(const std::string& mapPath, int height, int width) {
+  std::string key = mapPath + ':' + std::to_string(height) + 'x' + std::to_string(width);
+
+  std::lock_guard<std::mutex> lock(this->mapsMutex);
+  auto loaded = this->maps.find(key);
+  if (loaded != this->maps.end())
+    return loaded->second;
+
+  auto map = std::make_shared<t_map>();
+  try {
+    if (mapPath.empty())
+      throw "Map is not defined";
+
+    parseMap(map->walls, mapPath);
+  } catch (const char* err) {
+    std::cerr << err << ": fallback to an empty map" << std::endl;
+
+    map->walls.reset(width, height, FLOOR_TILE);
+  }
+
+  build(*map);
+
+  std::cout << "height: " << map->walls.getHeight() << ", width: " << map->walls.getWidth() << '\n';
+  printMap(map->walls);
+
+  this->maps[key] = map;
+  return map;
+}
+
+// Everything derived from the walls: the kernel's tile bytes and both MapData frames
+void MapRegistry::build(t_map& map) {
+  map.tiles.assign(map.walls.getSize() + HEAD_KERNEL_PADDING, FLOOR_TILE);
+  for (size_t i = 0; i < map.walls.getSize(); i++)
+    map.tiles[i] = map.walls[i].tile;
+
+  serializeMap(map);
+}
+
+void MapRegistry::parseMap(Grid& walls, const std::string& mapPath) {
+  std::ifstream file(mapPath);
+  if (!file.is_open())
+    throw "Error opening map";
+
+  int width = 0;
+  std::string line;
+  std::vector<std::string> lines;
+
+  while (getline(file, line)) {
+    if (!width)
+      width = line.size();
+
+    if (hasInvalidChars(line)) {
+      file.close();
+      throw "Invalid characters";
+    }
+
+    if ((int)line.size() != width) {
+      file.close();
+      throw "Invalid line width";
+    }
+
+    lines.push_back(line);
+  }
+
+  if (!file.eof()) {
+    file.close();
+    throw "Error reading assets file";
+  }
+
+  file.close();
+
+  if (lines.empty() || !width)
+    throw "Empty map";
+
+  walls.reset(width, lines.size(), FLOOR_TILE);
+  for (size_t y = 0; y < lines.size(); y++)
+    walls.setRow(y, lines[y]);
+}
+
+static Tile toTile(char tile) {
+  if (tile == WALL_HORIZ_TILE)
+    return Tile_WallHorizontal;
+  if (tile == WALL_VERTI_TILE)
+    return Tile_WallVertical;
+  return Tile_Empty;
+}
+
+// Both encodings, built once per map rather than once per room or player
+void MapRegistry::serializeMap(t_map& map) {
+  const Grid& walls = map.walls;
+  FrameBuilder frameBuilder;
+
+  // keeps the default player_id in the buffer so it can be patched per client
+  flatbuffers::FlatBufferBuilder& builder = frameBuilder.start(true);
+
+  std::vector<flatbuffers::Offset<Row>> rows;
+  rows.reserve(walls.getHeight());
+
+  for (int y = 0; y < walls.getHeight(); y++) {
+    std::vector<int8_t> tiles;
+    tiles.reserve(walls.getWidth());
+
+    for (int x = 0; x < walls.getWidth(); x++)
+      tiles.emplace_back(toTile(walls.getTile(x, y)));
+
+    auto tilesData = builder.CreateVector(tiles);
+    rows.emplace_back(CreateRow(builder, tilesData));
+  }
+
+  auto rowsData = builder.CreateVector(rows);
+  auto mapData = CreateMapData(builder, rowsData);
+  builder.Finish(CreatePacket(builder, MsgType_Map, MsgUnion_MapData, mapData.Union()));
+  map.frame = frameBuilder.finish();
+
+  frameBuilder.start();
+
+  std::vector<uint8_t> packed((walls.getSize() + 3) / 4, 0);
+  for (size_t i = 0; i < walls.getSize(); i++)
+    packed[i / 4] |= toTile(walls[i].tile) << (i % 4 * 2);
+
+  auto packedData = builder.CreateVector(packed);
+  auto packedMapData = CreateMapData(builder, 0, 0, walls.getWidth(), walls.getHeight(), packedData);
+  builder.Finish(CreatePacket(builder, MsgType_Map, MsgUnion_MapData, packedMapData.Union()));
+  map.packedFrame = frameBuilder.finish();
+}
+
+void MapRegistry::printMap(const Grid& walls) {
+  std::cout << "\n\n";
+  for (int y = 0; y < walls.getHeight(); y++)
+    std::cout << std::setw(3) << y << ':' << walls.getRow(y) << '\n';
+  std::cout << "\n\n";
+}
+
+bool hasInvalidChars(const std::string& line) {
+  for (char c : line) {
+    if (c != FLOOR_TILE && c != WALL_HORIZ_TILE && c != WALL_VERTI_TILE)
+      return true;
+  }
+  return false;
+}
@@ -0,0 +1,38 @@
+#ifndef MAP_REGISTRY_HPP
+#define MAP_REGISTRY_HPP
+
+#include "../includes/nibbler.hpp"
+#include "Grid.hpp"
+#include "HeadKernel.hpp"
+
+// Walls of one map, never modified once loaded. Every room playing it shares the same copy.
+typedef struct s_map {
+  Grid walls;                 // wall and floor tiles, the free index holds every floor cell
+  std::vector<char> tiles;    // the same tiles one byte per cell, padded for the head kernel
+  t_frame_buffer frame;       // MapData in rows, player_id left at its default for patching
+  t_frame_buffer packedFrame; // MapData in 2-bit tiles
+} t_map;
+
+// Parses each map file once, a room opened on a map already loaded costs no parsing or wall copy
+class MapRegistry {
+public:
+  MapRegistry();
+  MapRegistry(const MapRegistry& obj) = delete;
+  MapRegistry& operator=(const MapRegistry& obj) = delete;
+  MapRegistry(MapRegistry&& obj) = delete;
+  MapRegistry& operator=(MapRegistry&& obj) = delete;
+  ~MapRegistry();
+
+  std::shared_ptr<const t_map> load(const std::string& mapPath, int height, int width);
+  static void build(t_map& map);
+
+private:
+  std::mutex mapsMutex;
+  std::unordered_map<std::string, std::shared_ptr<const t_map>> maps; // by path
+
+  static void parseMap(Grid& walls, const std::string& mapPath);
+  static void serializeMap(t_map& map);
+  static void printMap(const Grid& walls);
+};
+
+#endif
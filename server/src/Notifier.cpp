@@ -0,0 +1,64 @@
+#include "Notifier.hpp"
+#include <errno.h>
+
+#ifdef __linux__
+#include <sys/eventfd.h>
+
+Notifier::Notifier() {
+  this->readFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if (this->readFd == -1)
+    throw "Failed to create eventfd";
+
+  this->writeFd = this->readFd;
+}
+
+Notifier::~Notifier() { close(this->readFd); }
+
+void Notifier::notify() {
+  uint64_t one = 1;
+  while (write(this->writeFd, &one, sizeof(one)) == -1 && errno == EINTR)
+    ;
+}
+
+void Notifier::drain() {
+  uint64_t count;
+  while (read(this->readFd, &count, sizeof(count)) == -1 && errno == EINTR)
+    ;
+}
+
+#else
+
+Notifier::Notifier() {
+  int fds[2];
+  if (pipe(fds) == -1)
+    throw "Failed to create notification pipe";
+
+  this->readFd = fds[0];
+  this->writeFd = fds[1];
+  fcntl(this->readFd, F_SETFL, O_NONBLOCK);
+  fcntl(this->writeFd, F_SETFL, O_NONBLOCK);
+}
+
+Notifier::~Notifier() {
+  close(this->readFd);
+  close(this->writeFd);
+}
+
+// a full pipe already guarantees a pending wakeup
+void Notifier::notify() {
+  char byte = 1;
+  while (write(this->writeFd, &byte, 1) == -1 && errno == EINTR)
+    ;
+}
+
+void Notifier::drain() {
+  char buffer[64];
+  ssize_t n;
+  do {
+    n = read(this->readFd, buffer, sizeof(buffer));
+  } while (n > 0 || (n == -1 && errno == EINTR));
+}
+
+#endif
+
+int Notifier::getFd() const { return this->readFd; }
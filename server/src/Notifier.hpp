@@ -0,0 +1,26 @@
+#ifndef NOTIFIER_HPP
+#define NOTIFIER_HPP
+
+#include "../includes/nibbler.hpp"
+
+// Lets another thread wake up the event loop: eventfd on Linux, a self-pipe elsewhere.
+class Notifier {
+public:
+  Notifier();
+  Notifier(const Notifier& obj) = delete;
+  Notifier& operator=(const Notifier& obj) = delete;
+  Notifier(Notifier&& obj) = delete;
+  Notifier& operator=(Notifier&& obj) = delete;
+  ~Notifier();
+
+  void notify();
+  void drain();
+
+  int getFd() const;
+
+private:
+  int readFd;
+  int writeFd;
+};
+
+#endif
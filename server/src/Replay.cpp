@@ -0,0 +1,249 @@
+#include "Replay.hpp"
+
+#define MAGIC_SIZE 8
+#define FNV_OFFSET_BASIS 14695981039346656037ULL
+#define FNV_PRIME 1099511628211ULL
+
+ReplayWriter::ReplayWriter(const std::string& path, const t_replay_header& header)
+    : isClosing(false), isFailed(false) {
+  this->file = fopen(path.c_str(), "wbx");
+  if (!this->file)
+    throw "Failed to create the replay file";
+
+  this->buffer.insert(this->buffer.end(), REPLAY_MAGIC, REPLAY_MAGIC + MAGIC_SIZE);
+  putU64(header.seed);
+  putU32(header.height);
+  putU32(header.width);
+  putU64(header.mapDigest);
+  putU16(header.mapPath.size());
+  this->buffer.insert(this->buffer.end(), header.mapPath.begin(), header.mapPath.end());
+
+  if (fwrite(this->buffer.data(), 1, this->buffer.size(), this->file) != this->buffer.size() ||
+      fflush(this->file) != 0) {
+    fclose(this->file);
+    throw "Failed to write the replay header";
+  }
+
+  this->writer = std::thread(&ReplayWriter::runWriter, this);
+}
+
+// Whatever is still queued is written before the file is closed
+ReplayWriter::~ReplayWriter() {
+  {
+    std::lock_guard<std::mutex> lock(this->pendingMutex);
+    this->isClosing = true;
+  }
+  this->pendingReady.notify_one();
+  this->writer.join();
+  fclose(this->file);
+}
+
+// Clock thread. A failed write or a disk too far behind stops the recording, the server keeps
+// running without it.
+void ReplayWriter::write(const t_replay_record& record) {
+  if (this->isFailed.load())
+    return;
+
+  this->buffer.clear();
+  putU8(record.kind);
+  putU32(record.tick);
+  putU16(record.rooms.size());
+
+  for (const t_replay_room& room : record.rooms) {
+    putU16(room.id);
+    if (record.kind == REPLAY_CHECKPOINT) {
+      putU64(room.digest);
+      continue;
+    }
+
+    putU16(room.commands.size());
+    for (const t_command& command : room.commands) {
+      putU8(command.type);
+      putU32(command.id);
+      putU32(command.value);
+    }
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(this->pendingMutex);
+    if (this->pending.size() + this->buffer.size() > REPLAY_MAX_PENDING) {
+      this->isFailed.store(true);
+      std::cerr << "Replay file too far behind, recording stopped" << std::endl;
+      return;
+    }
+    this->pending.insert(this->pending.end(), this->buffer.begin(), this->buffer.end());
+  }
+  this->pendingReady.notify_one();
+}
+
+// Takes everything queued at once and writes it outside the lock, the records that come in
+// meanwhile go out with the next batch
+void ReplayWriter::runWriter() {
+  std::vector<uint8_t> batch;
+
+  while (true) {
+    {
+      std::unique_lock<std::mutex> lock(this->pendingMutex);
+      this->pendingReady.wait(lock, [this] { return this->isClosing || !this->pending.empty(); });
+      if (this->pending.empty())
+        return;
+      batch.swap(this->pending);
+    }
+
+    if (!this->isFailed.load() &&
+        (fwrite(batch.data(), 1, batch.size(), this->file) != batch.size() || fflush(this->file) != 0)) {
+      this->isFailed.store(true);
+      std::cerr << "Failed to write the replay file, recording stopped" << std::endl;
+    }
+    batch.clear();
+  }
+}
+
+void ReplayWriter::putU8(uint8_t value) { this->buffer.push_back(value); }
+
+void ReplayWriter::putU16(uint16_t value) {
+  for (size_t i = 0; i < sizeof(value); i++)
+    this->buffer.push_back(value >> (i * 8));
+}
+
+void ReplayWriter::putU32(uint32_t value) {
+  for (size_t i = 0; i < sizeof(value); i++)
+    this->buffer.push_back(value >> (i * 8));
+}
+
+void ReplayWriter::putU64(uint64_t value) {
+  for (size_t i = 0; i < sizeof(value); i++)
+    this->buffer.push_back(value >> (i * 8));
+}
+
+ReplayReader::ReplayReader(const std::string& path) : isTruncated(false) {
+  this->file = fopen(path.c_str(), "rb");
+  if (!this->file)
+    throw "Failed to open the replay file";
+
+  char magic[MAGIC_SIZE];
+  uint32_t height;
+  uint32_t width;
+  uint16_t pathSize;
+  if (fread(magic, 1, MAGIC_SIZE, this->file) != MAGIC_SIZE || memcmp(magic, REPLAY_MAGIC, MAGIC_SIZE) ||
+      !getU64(this->header.seed) || !getU32(height) || !getU32(width) || !getU64(this->header.mapDigest) ||
+      !getU16(pathSize)) {
+    fclose(this->file);
+    throw "Not a replay file";
+  }
+
+  this->header.height = height;
+  this->header.width = width;
+  this->header.mapPath.resize(pathSize);
+  if (fread(&this->header.mapPath[0], 1, pathSize, this->file) != pathSize) {
+    fclose(this->file);
+    throw "Not a replay file";
+  }
+}
+
+ReplayReader::~ReplayReader() { fclose(this->file); }
+
+bool ReplayReader::next(t_replay_record& record) {
+  uint8_t kind;
+  if (!getU8(kind))
+    return false;
+  if (kind != REPLAY_TICK && kind != REPLAY_CHECKPOINT)
+    throw "Corrupted replay record";
+
+  uint16_t roomCount;
+  record.kind = (enum e_replay_record)kind;
+  if (!getU32(record.tick) || !getU16(roomCount)) {
+    this->isTruncated = true;
+    return false;
+  }
+
+  // resized rather than rebuilt, the vectors keep their capacity from one record to the next
+  record.rooms.resize(roomCount);
+  for (t_replay_room& room : record.rooms) {
+    uint16_t id;
+    if (!getU16(id)) {
+      this->isTruncated = true;
+      return false;
+    }
+    room.id = id;
+
+    if (kind == REPLAY_CHECKPOINT) {
+      if (!getU64(room.digest)) {
+        this->isTruncated = true;
+        return false;
+      }
+      continue;
+    }
+
+    uint16_t commandCount;
+    if (!getU16(commandCount)) {
+      this->isTruncated = true;
+      return false;
+    }
+
+    room.commands.resize(commandCount);
+    for (t_command& command : room.commands) {
+      uint8_t type;
+      uint32_t commandId;
+      uint32_t value;
+      if (!getU8(type) || !getU32(commandId) || !getU32(value)) {
+        this->isTruncated = true;
+        return false;
+      }
+      command = {(e_command)type, (int)commandId, (int)value};
+    }
+  }
+  return true;
+}
+
+const t_replay_header& ReplayReader::getHeader() const { return this->header; }
+
+bool ReplayReader::getIsTruncated() const { return this->isTruncated; }
+
+bool ReplayReader::getU8(uint8_t& value) { return fread(&value, 1, 1, this->file) == 1; }
+
+bool ReplayReader::getU16(uint16_t& value) {
+  uint8_t bytes[sizeof(value)];
+  if (fread(bytes, 1, sizeof(bytes), this->file) != sizeof(bytes))
+    return false;
+
+  value = 0;
+  for (size_t i = 0; i < sizeof(value); i++)
+    value |= (uint16_t)bytes[i] << (i * 8);
+  return true;
+}
+
+bool ReplayReader::getU32(uint32_t& value) {
+  uint8_t bytes[sizeof(value)];
+  if (fread(bytes, 1, sizeof(bytes), this->file) != sizeof(bytes))
+    return false;
+
+  value = 0;
+  for (size_t i = 0; i < sizeof(value); i++)
+    value |= (uint32_t)bytes[i] << (i * 8);
+  return true;
+}
+
+bool ReplayReader::getU64(uint64_t& value) {
+  uint8_t bytes[sizeof(value)];
+  if (fread(bytes, 1, sizeof(bytes), this->file) != sizeof(bytes))
+    return false;
+
+  value = 0;
+  for (size_t i = 0; i < sizeof(value); i++)
+    value |= (uint64_t)bytes[i] << (i * 8);
+  return true;
+}
+
+// FNV-1a over the wall rows as the registry parsed them
+uint64_t hashWalls(const Grid& walls) {
+  uint64_t hash = FNV_OFFSET_BASIS;
+
+  for (int y = 0; y < walls.getHeight(); y++) {
+    for (char tile : walls.getRow(y)) {
+      hash ^= (uint8_t)tile;
+      hash *= FNV_PRIME;
+    }
+  }
+  return hash;
+}
@@ -0,0 +1,99 @@
+#ifndef REPLAY_HPP
+#define REPLAY_HPP
+
+#include "../includes/nibbler.hpp"
+#include "CommandQueue.hpp"
+#include "Grid.hpp"
+#include <condition_variable>
+
+#define REPLAY_MAGIC "NIBREPL1"
+#define REPLAY_CHECKPOINT_TICKS 100 // recorded ticks between two digests of the rooms
+#define REPLAY_MAX_PENDING (64 * 1024 * 1024) // queued behind a stalled disk before recording stops
+
+enum e_replay_record { REPLAY_TICK = 1, REPLAY_CHECKPOINT = 2 };
+
+// Everything a room needs besides its inputs: the process seed and the map it was played on
+typedef struct s_replay_header {
+  uint64_t seed;
+  int height;
+  int width;
+  uint64_t mapDigest; // the replay refuses a map file that changed since
+  std::string mapPath;
+} t_replay_header;
+
+typedef struct s_replay_room {
+  int id;
+  std::vector<t_command> commands; // REPLAY_TICK, what the room applied, in order
+  uint64_t digest;                 // REPLAY_CHECKPOINT, hashSnapshot of its published state
+} t_replay_room;
+
+// One RoomManager tick: the rooms that ran it, in id order. Ticks where every room was idle are
+// not written.
+typedef struct s_replay_record {
+  enum e_replay_record kind;
+  uint32_t tick;
+  std::vector<t_replay_room> rooms;
+} t_replay_record;
+
+// Append-only, one record per tick. Integers are little-endian whatever the host, a command is 9
+// bytes and a room without input 4. Throws when the file exists already, a recording is never
+// overwritten. write() only encodes and queues the record, its own thread writes and flushes
+// the file, so a slow disk never holds up the tick being recorded.
+class ReplayWriter {
+public:
+  ReplayWriter(const std::string& path, const t_replay_header& header);
+  ReplayWriter(const ReplayWriter& obj) = delete;
+  ReplayWriter& operator=(const ReplayWriter& obj) = delete;
+  ReplayWriter(ReplayWriter&& obj) = delete;
+  ReplayWriter& operator=(ReplayWriter&& obj) = delete;
+  ~ReplayWriter();
+
+  void write(const t_replay_record& record);
+
+private:
+  FILE* file;
+  std::vector<uint8_t> buffer; // the record being encoded, clock thread only
+
+  // Shared with the writing thread
+  std::mutex pendingMutex;
+  std::condition_variable pendingReady;
+  std::vector<uint8_t> pending; // encoded records not written yet
+  bool isClosing;
+  std::atomic<bool> isFailed;
+  std::thread writer;
+
+  void runWriter();
+  void putU8(uint8_t value);
+  void putU16(uint16_t value);
+  void putU32(uint32_t value);
+  void putU64(uint64_t value);
+};
+
+class ReplayReader {
+public:
+  ReplayReader(const std::string& path); // throws on a missing file or a bad header
+  ReplayReader(const ReplayReader& obj) = delete;
+  ReplayReader& operator=(const ReplayReader& obj) = delete;
+  ReplayReader(ReplayReader&& obj) = delete;
+  ReplayReader& operator=(ReplayReader&& obj) = delete;
+  ~ReplayReader();
+
+  // False at the end of the file, or on a last record cut short when the server died mid-write
+  bool next(t_replay_record& record);
+  const t_replay_header& getHeader() const;
+  bool getIsTruncated() const;
+
+private:
+  FILE* file;
+  t_replay_header header;
+  bool isTruncated;
+
+  bool getU8(uint8_t& value);
+  bool getU16(uint16_t& value);
+  bool getU32(uint32_t& value);
+  bool getU64(uint64_t& value);
+};
+
+uint64_t hashWalls(const Grid& walls);
+
+#endif
@@ -0,0 +1,354 @@
+#include "RoomManager.hpp"
+#include <algorithm>
+#include <chrono>
+
+using Clock = std::chrono::steady_clock;
+
+RoomManager::RoomManager(int height, int width, const std::string& mapPath, size_t workerCount, uint64_t seed,
+                         const std::string& replayPath)
+    : height(height), width(width), mapPath(mapPath), rooms(MAX_ROOMS, nullptr), roomCount(0), seed(seed),
+      stopFlag(false), isDataUpdated(false), workerCount(workerCount ? workerCount : 1),
+      ranges(this->workerCount), round(0), busyWorkers(0), stage(STAGE_BEGIN), replayWriter(nullptr),
+      tickCount(0), recordedTicks(0) {
+  // loads the map, later rooms find it in the registry
+  openRoom(0);
+
+  if (!replayPath.empty()) {
+    t_replay_header header = {seed, height, width, hashWalls(this->rooms[0]->getMap().walls), mapPath};
+    this->replayWriter = new ReplayWriter(replayPath, header);
+    std::cout << "Recording replay: " << replayPath << std::endl;
+  }
+
+  std::cout << "Tick workers: " << this->workerCount << std::endl;
+}
+
+RoomManager::~RoomManager() {
+  delete this->replayWriter;
+  for (size_t id = 0; id < this->roomCount.load(); id++)
+    delete this->rooms[id];
+}
+
+// Blocks until stop(), the calling thread keeps the clock and ticks its share of the rooms
+void RoomManager::start() {
+  startWorkers();
+
+  auto nextMoveTime = Clock::now() + std::chrono::milliseconds(SNAKE_SPEED);
+
+  while (!this->stopFlag.load()) {
+    auto now = Clock::now();
+    if (now >= nextMoveTime) {
+      runTick();
+      setIsDataUpdated(true);
+      nextMoveTime = now + std::chrono::milliseconds(SNAKE_SPEED);
+    }
+
+    std::this_thread::sleep_until(nextMoveTime);
+  }
+
+  joinWorkers();
+
+  // every room as the run left it, the last thing a replay checks
+  if (this->replayWriter) {
+    std::vector<size_t> roomIds(this->roomCount.load());
+    for (size_t id = 0; id < roomIds.size(); id++)
+      roomIds[id] = id;
+    recordCheckpoint(roomIds);
+  }
+}
+
+void RoomManager::stop() {
+  {
+    std::lock_guard<std::mutex> lock(this->roundMutex);
+    this->stopFlag.store(true);
+  }
+  this->roundStarted.notify_all();
+  this->updateNotifier.notify();
+}
+
+// Plays a recording back as fast as the workers go, no clock and no network: the rooms each record
+// names run the same stages with the commands they applied when it was made, and every checkpoint
+// is compared with the state reached. The map and seed must be the recording's, see ReplayReader.
+t_replay_stats RoomManager::replay(ReplayReader& reader) {
+  if (hashWalls(this->rooms[0]->getMap().walls) != reader.getHeader().mapDigest)
+    throw "The map differs from the recorded one";
+
+  t_replay_stats stats = t_replay_stats();
+  t_replay_record record;
+  startWorkers();
+
+  try {
+    while (reader.next(record)) {
+      if (record.kind == REPLAY_CHECKPOINT)
+        checkCheckpoint(record, stats);
+      else
+        replayTick(record, stats);
+    }
+  } catch (const char*) {
+    stop();
+    joinWorkers();
+    throw;
+  }
+
+  stop();
+  joinWorkers();
+  return stats;
+}
+
+// The calling thread is worker 0
+void RoomManager::startWorkers() {
+  for (size_t i = 1; i < this->workerCount; i++)
+    this->workers.emplace_back(&RoomManager::runWorker, this, i);
+}
+
+void RoomManager::joinWorkers() {
+  for (auto& worker : this->workers)
+    worker.join();
+  this->workers.clear();
+}
+
+// Idle rooms are skipped, the others are recorded with what they applied
+void RoomManager::runTick() {
+  size_t count = this->roomCount.load();
+
+  this->tickCount++;
+  this->activeRooms.clear();
+  this->activeRoomIds.clear();
+  for (size_t id = 0; id < count; id++) {
+    if (!this->rooms[id]->isIdle()) {
+      this->activeRooms.push_back(this->rooms[id]);
+      this->activeRoomIds.push_back(id);
+    }
+  }
+
+  runRooms();
+
+  if (this->replayWriter && !this->activeRooms.empty())
+    recordTick();
+}
+
+// Stages are separated by a full barrier, a room's moves are all proposed before it resolves them
+void RoomManager::runRooms() {
+  this->moveCounts.resize(this->activeRooms.size());
+  runStage(STAGE_BEGIN, this->activeRooms.size());
+
+  this->moveSlices.clear();
+  for (size_t i = 0; i < this->activeRooms.size(); i++) {
+    for (size_t begin = 0; begin < this->moveCounts[i]; begin += MOVE_SLICE_SIZE)
+      this->moveSlices.push_back(
+          {this->activeRooms[i], begin, std::min(begin + MOVE_SLICE_SIZE, this->moveCounts[i])});
+  }
+  runStage(STAGE_PROPOSE, this->moveSlices.size());
+
+  runStage(STAGE_END, this->activeRooms.size());
+}
+
+// A record's vectors keep their capacity, the steady tick only copies the inputs
+void RoomManager::recordTick() {
+  this->replayRecord.kind = REPLAY_TICK;
+  this->replayRecord.tick = this->tickCount;
+  this->replayRecord.rooms.resize(this->activeRooms.size());
+  for (size_t i = 0; i < this->activeRooms.size(); i++) {
+    this->replayRecord.rooms[i].id = this->activeRoomIds[i];
+    this->replayRecord.rooms[i].commands = this->activeRooms[i]->getTickInputs();
+  }
+  this->replayWriter->write(this->replayRecord);
+
+  if (++this->recordedTicks % REPLAY_CHECKPOINT_TICKS == 0)
+    recordCheckpoint(this->activeRoomIds);
+}
+
+// Rooms that never ticked have nothing to compare and are left out
+void RoomManager::recordCheckpoint(const std::vector<size_t>& roomIds) {
+  this->replayRecord.kind = REPLAY_CHECKPOINT;
+  this->replayRecord.tick = this->tickCount;
+  this->replayRecord.rooms.clear();
+  for (size_t id : roomIds) {
+    std::shared_ptr<const t_snapshot> snapshot = this->rooms[id]->getPublishedSnapshot();
+    if (snapshot)
+      this->replayRecord.rooms.push_back({(int)id, {}, hashSnapshot(*snapshot)});
+  }
+  this->replayWriter->write(this->replayRecord);
+}
+
+// Rooms open in id order here as they did in the recorded run, so each gets the same seed. The
+// commands go through the same rings the network thread fills.
+void RoomManager::replayTick(const t_replay_record& record, t_replay_stats& stats) {
+  this->tickCount = record.tick;
+  this->activeRooms.clear();
+  this->activeRoomIds.clear();
+
+  for (const t_replay_room& room : record.rooms) {
+    if ((size_t)room.id >= MAX_ROOMS)
+      throw "Replay room past MAX_ROOMS";
+    while (this->roomCount.load() <= (size_t)room.id)
+      openRoom(this->roomCount.load());
+
+    Game* game = this->rooms[room.id];
+    for (const t_command& command : room.commands) {
+      if (command.type == COMMAND_JOIN)
+        game->addSnake(command.id, command.value);
+      else if (command.type == COMMAND_LEAVE)
+        game->removeSnake(command.id);
+      else
+        game->updateSnakeDirection(command.id, command.value);
+    }
+
+    this->activeRooms.push_back(game);
+    this->activeRoomIds.push_back(room.id);
+    stats.commands += room.commands.size();
+  }
+
+  runRooms();
+
+  stats.ticks++;
+  stats.roomTicks += this->activeRooms.size();
+  for (size_t moveCount : this->moveCounts)
+    stats.snakeMoves += moveCount;
+}
+
+void RoomManager::checkCheckpoint(const t_replay_record& record, t_replay_stats& stats) const {
+  for (const t_replay_room& room : record.rooms) {
+    std::shared_ptr<const t_snapshot> snapshot;
+    if ((size_t)room.id < this->roomCount.load())
+      snapshot = this->rooms[room.id]->getPublishedSnapshot();
+
+    stats.checkpoints++;
+    if (snapshot && hashSnapshot(*snapshot) == room.digest)
+      continue;
+
+    if (!stats.mismatches) {
+      stats.firstMismatchTick = record.tick;
+      stats.firstMismatchRoom = room.id;
+    }
+    stats.mismatches++;
+  }
+}
+
+// Contiguous shares, so a worker keeps running the same rooms while nobody has to steal
+void RoomManager::runStage(enum e_stage stage, size_t itemCount) {
+  size_t share = (itemCount + this->workerCount - 1) / this->workerCount;
+
+  this->stage = stage;
+  for (size_t i = 0; i < this->workerCount; i++) {
+    this->ranges[i].next.store(std::min(i * share, itemCount));
+    this->ranges[i].end = std::min((i + 1) * share, itemCount);
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(this->roundMutex);
+    this->round++;
+    this->busyWorkers = this->workerCount - 1;
+  }
+  this->roundStarted.notify_all();
+
+  runShare(0);
+
+  std::unique_lock<std::mutex> lock(this->roundMutex);
+  this->roundFinished.wait(lock, [this] { return this->busyWorkers == 0; });
+}
+
+void RoomManager::runWorker(size_t index) {
+  uint64_t lastRound = 0;
+
+  while (true) {
+    {
+      std::unique_lock<std::mutex> lock(this->roundMutex);
+      this->roundStarted.wait(lock, [&] { return this->stopFlag.load() || this->round != lastRound; });
+      // a round already started is finished first, the clock waits for it
+      if (this->round == lastRound)
+        return;
+      lastRound = this->round;
+    }
+
+    runShare(index);
+
+    std::lock_guard<std::mutex> lock(this->roundMutex);
+    if (--this->busyWorkers == 0)
+      this->roundFinished.notify_one();
+  }
+}
+
+// Own share first, then whatever is left in the others'. An item is claimed by exactly one
+// worker, so a room is never in the same stage on two threads at once.
+void RoomManager::runShare(size_t index) {
+  for (size_t k = 0; k < this->workerCount; k++) {
+    t_room_range& range = this->ranges[(index + k) % this->workerCount];
+
+    size_t item;
+    while ((item = range.next.fetch_add(1)) < range.end)
+      runItem(item);
+  }
+}
+
+void RoomManager::runItem(size_t item) {
+  switch (this->stage) {
+  case STAGE_BEGIN:
+    this->moveCounts[item] = this->activeRooms[item]->beginTick();
+    break;
+  case STAGE_PROPOSE:
+    this->moveSlices[item].room->proposeMoves(this->moveSlices[item].begin, this->moveSlices[item].end);
+    break;
+  case STAGE_END:
+    this->activeRooms[item]->endTick();
+    break;
+  }
+}
+
+// Network thread. The first room with a free slot, a new one once they are all full. Returns the
+// room id, -1 when MAX_ROOMS are full.
+int RoomManager::join(int fd) {
+  size_t count = this->roomCount.load();
+
+  for (size_t id = 0; id < count; id++) {
+    if (this->rooms[id]->getPlayerCount() < MAX_PLAYERS) {
+      this->rooms[id]->addSnake(fd);
+      return id;
+    }
+  }
+
+  if (count == MAX_ROOMS)
+    return -1;
+
+  openRoom(count)->addSnake(fd);
+  std::cout << "Room opened: " << count << std::endl;
+  return count;
+}
+
+Game* RoomManager::openRoom(size_t id) {
+  this->rooms[id] = new Game(this->maps.load(this->mapPath, this->height, this->width), getRoomSeed(id));
+  this->roomCount.store(id + 1);
+  return this->rooms[id];
+}
+
+// splitmix64 of the process seed and the room id, well apart even for neighbouring seeds
+uint32_t RoomManager::getRoomSeed(size_t id) const {
+  uint64_t z = this->seed + (id + 1) * 0x9E3779B97F4A7C15ULL;
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+  return (z ^ (z >> 31)) >> 32;
+}
+
+void RoomManager::leave(int roomId, int fd) { this->rooms[roomId]->removeSnake(fd); }
+
+// Network thread, joins and leaves the command rings could not take during a storm
+void RoomManager::flushCommands() {
+  size_t count = this->roomCount.load();
+  for (size_t id = 0; id < count; id++)
+    this->rooms[id]->flushCommands();
+}
+
+void RoomManager::setIsDataUpdated(bool value) {
+  this->isDataUpdated.store(value);
+  if (value)
+    this->updateNotifier.notify(); // wake up the network loop
+}
+
+Game* RoomManager::getRoom(int roomId) const { return this->rooms[roomId]; }
+
+size_t RoomManager::getRoomCount() const { return this->roomCount.load(); }
+
+bool RoomManager::getStopFlag() const { return this->stopFlag.load(); }
+
+bool RoomManager::getIsDataUpdated() const { return this->isDataUpdated.load(); }
+
+Notifier& RoomManager::getUpdateNotifier() { return this->updateNotifier; }
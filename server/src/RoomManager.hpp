@@ -0,0 +1,125 @@
+#ifndef ROOM_MANAGER_HPP
+#define ROOM_MANAGER_HPP
+
+#include "../includes/nibbler.hpp"
+#include "Game.hpp"
+#include "MapRegistry.hpp"
+#include "Notifier.hpp"
+#include "Replay.hpp"
+#include <condition_variable>
+
+#define MOVE_SLICE_SIZE 256 // snakes proposing their moves in one work item
+
+// Items of a stage a worker runs before stealing from the others, padded so workers do not share
+// a line
+typedef struct alignas(64) s_room_range {
+  std::atomic<size_t> next;
+  size_t end;
+} t_room_range;
+
+enum e_stage { STAGE_BEGIN, STAGE_PROPOSE, STAGE_END };
+
+typedef struct s_move_slice {
+  Game* room;
+  size_t begin;
+  size_t end;
+} t_move_slice;
+
+typedef struct s_replay_stats {
+  uint64_t ticks;
+  uint64_t roomTicks;
+  uint64_t snakeMoves;
+  uint64_t commands;
+  uint64_t checkpoints; // room digests compared
+  uint64_t mismatches;  // of them, the ones that differ from the recording
+  uint32_t firstMismatchTick;
+  int firstMismatchRoom;
+} t_replay_stats;
+
+// Independent games in one process. Every SNAKE_SPEED ms a tick runs in three stages over a fixed
+// pool of workers: rooms begin their tick, moves are proposed in slices so a big room spreads over
+// several cores, rooms resolve and publish. A worker done with its share of a stage steals from
+// the others, and the network loop is woken once the whole tick is published. Rooms are only ever
+// added, by the network thread.
+// Each room draws from its own generator seeded from the process seed, so given the commands every
+// room applied on every tick a run can be played again exactly: with a replay path they are
+// appended to that file after each tick, replay() plays such a file back without the clock.
+class RoomManager {
+public:
+  RoomManager(int height, int width, const std::string& mapPath, size_t workerCount, uint64_t seed,
+              const std::string& replayPath = "");
+  RoomManager(const RoomManager& obj) = delete;
+  RoomManager& operator=(const RoomManager& obj) = delete;
+  RoomManager(RoomManager&& obj) = delete;
+  RoomManager& operator=(RoomManager&& obj) = delete;
+  ~RoomManager();
+
+  void start();
+  void stop();
+  t_replay_stats replay(ReplayReader& reader);
+
+  int join(int fd);
+  void leave(int roomId, int fd);
+  void flushCommands();
+  void setIsDataUpdated(bool value);
+
+  Game* getRoom(int roomId) const;
+  size_t getRoomCount() const;
+  bool getStopFlag() const;
+  bool getIsDataUpdated() const;
+  Notifier& getUpdateNotifier();
+
+private:
+  int height;
+  int width;
+  std::string mapPath;
+  MapRegistry maps;
+  std::vector<Game*> rooms;      // MAX_ROOMS slots, never reallocated
+  std::atomic<size_t> roomCount; // slots below it are set and visible to the workers
+  uint64_t seed;
+
+  // Used by another thread
+  std::atomic<bool> stopFlag;
+  std::atomic<bool> isDataUpdated;
+  Notifier updateNotifier;
+
+  // Worker 0 is the thread calling start(), it also keeps the tick clock
+  size_t workerCount;
+  std::vector<std::thread> workers;
+  std::vector<t_room_range> ranges; // one per worker, reset every stage
+  std::mutex roundMutex;
+  std::condition_variable roundStarted;
+  std::condition_variable roundFinished;
+  uint64_t round; // bumped for every stage
+  size_t busyWorkers;
+
+  // This tick's work, written by the clock thread between stages
+  enum e_stage stage;
+  std::vector<Game*> activeRooms;
+  std::vector<size_t> activeRoomIds;
+  std::vector<size_t> moveCounts; // per active room, set by STAGE_BEGIN
+  std::vector<t_move_slice> moveSlices;
+
+  // Clock thread, null unless the run is recorded
+  ReplayWriter* replayWriter;
+  t_replay_record replayRecord;
+  uint32_t tickCount;
+  uint32_t recordedTicks;
+
+  Game* openRoom(size_t id);
+  uint32_t getRoomSeed(size_t id) const;
+  void startWorkers();
+  void joinWorkers();
+  void runWorker(size_t index);
+  void runTick();
+  void runRooms();
+  void recordTick();
+  void recordCheckpoint(const std::vector<size_t>& roomIds);
+  void replayTick(const t_replay_record& record, t_replay_stats& stats);
+  void checkCheckpoint(const t_replay_record& record, t_replay_stats& stats) const;
+  void runStage(enum e_stage stage, size_t itemCount);
+  void runShare(size_t index);
+  void runItem(size_t item);
+};
+
+#endif
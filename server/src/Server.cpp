@@ -1,12 +1,27 @@
 #include "Server.hpp"
+#include <algorithm>
+#include <sys/resource.h>
+#include <chrono>
 #include <sys/uio.h>
 
 #define SERV_PORT 8080
-#define MAX_CLIENT_CONNECTIONS 10
-#define NON_BLOCKING 0
+#define LISTEN_BACKLOG SOMAXCONN
 #define BLOCKING -1
-
-Server::Server(Game* game) : game(game) {}
+#define READ_BUFFER_SIZE 512
+#define SUPPORTED_FEATURES                                                                                   \
+  (Feature_DeltaSnapshots | Feature_PackedBodies | Feature_PackedMap | Feature_UdpSnapshots)
+#define INPUT_BATCH_SIZE 64
+#define INPUT_BUFFER_SIZE 16
+#define LEGACY_INPUT_SIZE 2 // direction, padding
+#define INPUT_SIZE 6        // direction, padding, session token big-endian
+#define BIND_SIZE 4         // session token big-endian
+#define DATAGRAM_BATCH_SIZE 64
+#define MAX_SNAPSHOT_DATAGRAM 1200 // bigger snapshots take TCP rather than risk IP fragmentation
+
+Server::Server(RoomManager* rooms, size_t sendQueueBudget, bool isZerocopy)
+    : rooms(rooms), tcpServerFd(-1), udpServerFd(-1), hasPendingAccepts(false), sendQueueBudget(sendQueueBudget),
+      isZerocopy(isZerocopy),
+      tickLatency("simulate-to-send"), tokenGenerator(std::random_device()()) {}
 
 void Server::setupSocket(int socket) {
   int flag = 1; // Disable Nagle's Algorithm
@@ -15,14 +30,26 @@ void Server::setupSocket(int socket) {
 
 Server::~Server() {
   std::cout << "Server Destructor called!" << std::endl;
-  for (const auto client : connectedClients) {
-    close(client.fd);
+  for (const int fd : clientFds) {
+    close(fd);
+    delete connections[fd];
   }
+  for (t_room_feed* feed : feeds)
+    delete feed;
 
   close(this->tcpServerFd);
   close(this->udpServerFd);
 }
 
+// every session costs one fd, so lift the soft limit as far as we are allowed
+static void raiseOpenFileLimit() {
+  struct rlimit limit;
+  if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < limit.rlim_max) {
+    limit.rlim_cur = limit.rlim_max;
+    setrlimit(RLIMIT_NOFILE, &limit);
+  }
+}
+
 void Server::initConnections() {
   struct sockaddr_in serverAddr;
 
@@ -30,6 +57,8 @@ void Server::initConnections() {
   serverAddr.sin_addr.s_addr = htonl(INADDR_ANY);
   serverAddr.sin_port = htons(SERV_PORT);
 
+  raiseOpenFileLimit();
+
   this->tcpServerFd = socket(AF_INET, SOCK_STREAM, 0);
   if (this->tcpServerFd == -1)
     throw "Failed to create a tcp socket";
@@ -40,7 +69,7 @@ void Server::initConnections() {
     throw "Failed to assign address to a tcp socket";
 
   // make socket passive to accept incoming connection requests
-  if (listen(this->tcpServerFd, MAX_CLIENT_CONNECTIONS) == -1)
+  if (listen(this->tcpServerFd, LISTEN_BACKLOG) == -1)
     throw "Failed to make tcp socket passive";
 
   if (fcntl(this->tcpServerFd, F_SETFL, O_NONBLOCK) == -1)
@@ -53,190 +82,608 @@ void Server::initConnections() {
   if (bind(this->udpServerFd, (struct sockaddr*)&serverAddr, sizeof(serverAddr)) == -1)
     throw "Failed to assign address to a udp socket";
 
-  pollfd tcpPoll = {tcpServerFd, POLLIN, 0};
-  pollfd udpPoll = {udpServerFd, POLLIN, 0};
-  pollfd stdin = {STDIN_FILENO, POLLIN, 0};
-  connectedClients.push_back(tcpPoll);
-  connectedClients.push_back(udpPoll);
-  connectedClients.push_back(stdin);
+  if (fcntl(this->udpServerFd, F_SETFL, O_NONBLOCK) == -1)
+    throw "Failed to make udp socket non-blocking";
+
+  if (!eventLoop.add(tcpServerFd, EVENT_READ))
+    throw "Failed to watch tcp socket";
+  if (!eventLoop.add(udpServerFd, EVENT_READ))
+    throw "Failed to watch udp socket";
+  if (!eventLoop.add(rooms->getUpdateNotifier().getFd(), EVENT_READ))
+    throw "Failed to watch game updates";
+  if (!eventLoop.add(STDIN_FILENO, EVENT_READ))
+    std::cerr << "Admin input is not available" << std::endl;
 }
 
 void Server::start() {
   try {
     this->initConnections();
 
-    while (!this->game->getStopFlag()) {
-      if (poll(connectedClients.data(), connectedClients.size(), BLOCKING) < 0)
+    while (!this->rooms->getStopFlag()) {
+      int readyCount = this->eventLoop.wait(BLOCKING);
+      if (readyCount < 0)
         break;
 
-      bool shouldSend = this->game->getIsDataUpdated();
-      if (shouldSend) {
-        this->game->setIsDataUpdated(false);
-        constructGameData();
-      }
+      for (int i = 0; i < readyCount; i++) {
+        const t_ioevent& event = this->eventLoop.getEvent(i);
 
-      for (const auto client : connectedClients) {
-        if (client.revents & POLLIN)
-          receiveDataFromClient(client.fd);
-        else if (client.revents & POLLOUT && shouldSend)
-          sendGameData(client.fd);
-        else if (client.revents & (POLLERR | POLLHUP | POLLNVAL))
-          handleSocketError(client.fd);
+        if (event.events & EVENT_READ)
+          receiveDataFromClient(event.fd);
+        if (event.events & EVENT_WRITE)
+          flushConnection(event.fd);
+        if (event.events & EVENT_ERROR)
+          handleSocketError(event.fd);
       }
 
-      if (this->closedConnections.size())
-        removeClosedConnections();
-      if (this->newConnections.size())
-        addNewConnections();
+      // accepted after the batch, so a reused fd never receives a stale event
+      if (this->hasPendingAccepts)
+        acceptNewConnections();
+
+      // joins and leaves the command ring could not take during a storm
+      this->rooms->flushCommands();
+
+      if (this->rooms->getIsDataUpdated()) {
+        this->rooms->setIsDataUpdated(false);
+        if (constructGameData()) {
+          broadcastGameData();
+
+          auto now = std::chrono::steady_clock::now().time_since_epoch();
+          int64_t nowNanos = std::chrono::duration_cast<std::chrono::nanoseconds>(now).count();
+          for (const t_room_feed* feed : this->feeds) {
+            if (feed->isUpdated)
+              this->tickLatency.record(nowNanos - feed->snapshots.find(feed->lastTick)->simulatedAt);
+          }
+        }
+      }
     }
   } catch (const char* msg) {
     std::cerr << msg << std::endl;
   }
 
-  this->game->stop();
+  this->tickLatency.print(std::cout);
+
+  this->rooms->stop();
 }
 
-void Server::acceptNewConnection() {
+void Server::acceptNewConnections() {
   struct sockaddr_in cliAddr;
-  socklen_t cliLen = sizeof(cliAddr);
+  socklen_t cliLen;
+
+  while (true) {
+    cliLen = sizeof(cliAddr);
+    int clientFd = accept(this->tcpServerFd, (struct sockaddr*)&cliAddr, &cliLen);
+    if (clientFd < 0) {
+      if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+        perror("accept");
+      if (errno != EINTR)
+        break;
+      continue;
+    }
 
-  int clientFd = accept(this->tcpServerFd, (struct sockaddr*)&cliAddr, &cliLen);
-  if (clientFd >= 0) {
-    if (fcntl(clientFd, F_SETFL, O_NONBLOCK) == -1) {
-      std::cerr << "Failed to make client fd non-blocking" << std::endl;
-      return;
+    if (fcntl(clientFd, F_SETFL, O_NONBLOCK) == -1 || !this->eventLoop.add(clientFd, EVENT_READ)) {
+      std::cerr << "Failed to register client fd: " << clientFd << std::endl;
+      close(clientFd);
+      continue;
     }
 
-    struct pollfd fd;
-    fd.fd = clientFd;
-    fd.events = POLLIN | POLLOUT;
-    fd.revents = 0;
-    this->newConnections.push_back(fd);
+    int roomId = this->rooms->join(clientFd);
+    if (roomId < 0) {
+      std::cerr << "Every room is full: " << clientFd << std::endl;
+      this->eventLoop.remove(clientFd);
+      close(clientFd);
+      continue;
+    }
 
+    // until its Hello, the client may be an old one steering by ip alone
+    addConnection(clientFd, roomId, cliAddr.sin_addr.s_addr);
     this->addressToFd[cliAddr.sin_addr.s_addr] = clientFd;
 
-    this->game->addSnake(clientFd);
-
+    // the map waits for the Hello to pick its encoding, or for the first snapshot on old clients
     std::cout << "Connected: " << clientFd << std::endl;
+  }
+
+  this->hasPendingAccepts = false;
+}
+
+void Server::addConnection(const int fd, int roomId, in_addr_t address) {
+  if ((int)this->connections.size() <= fd)
+    this->connections.resize(fd + 1, nullptr);
+
+  Connection* connection = new Connection(fd, address);
+  connection->setSlot(this->clientFds.size());
+  connection->setRoomId(roomId);
+  if (this->isZerocopy && !connection->enableZerocopy())
+    std::cerr << "MSG_ZEROCOPY not supported, copying sends: " << fd << std::endl;
+
+  uint32_t token;
+  do
+    token = this->tokenGenerator();
+  while (token == 0 || this->tokenToFd.count(token));
+  connection->setToken(token);
+  this->tokenToFd[token] = fd;
+
+  this->connections[fd] = connection;
+  this->clientFds.push_back(fd);
+}
+
+Connection* Server::getConnection(const int fd) const {
+  if (fd < 0 || fd >= (int)this->connections.size())
+    return nullptr;
+  return this->connections[fd];
+}
 
-    sendMapData(clientFd);
+// Created on first use, a room opened since the last broadcast has no feed yet
+t_room_feed* Server::getFeed(int roomId) {
+  while ((int)this->feeds.size() <= roomId) {
+    t_room_feed* feed = new t_room_feed();
+    feed->lastTick = 0;
+    feed->isUpdated = false;
+    this->feeds.push_back(feed);
   }
+  return this->feeds[roomId];
 }
 
 void Server::closeConnection(const int fd) {
+  Connection* connection = getConnection(fd);
+  if (!connection)
+    return;
+
+  // swap with the last client so removal stays O(1)
+  int lastFd = this->clientFds.back();
+  this->clientFds[connection->getSlot()] = lastFd;
+  this->connections[lastFd]->setSlot(connection->getSlot());
+  this->clientFds.pop_back();
+
+  this->tokenToFd.erase(connection->getToken());
+  auto endpoint = this->endpointToFd.find(connection->getEndpoint());
+  if (endpoint != this->endpointToFd.end() && endpoint->second == fd)
+    this->endpointToFd.erase(endpoint);
+  releaseAddress(connection);
+
+  int roomId = connection->getRoomId();
+  this->connections[fd] = nullptr;
+  delete connection;
+
+  this->eventLoop.remove(fd);
   close(fd);
-  this->closedConnections.push_back(fd);
-  this->game->removeSnake(fd);
+  this->rooms->leave(roomId, fd);
   std::cout << "Client removed: " << fd << std::endl;
 }
 
-void Server::addNewConnections() {
-  for (const auto connection : newConnections)
-    this->connectedClients.push_back(connection);
+// Takes the newest snapshot every room published, game state itself is never read here. False
+// when no room has anything new since the last broadcast.
+bool Server::constructGameData() {
+  this->frameBuilder.rewind();
+  bool isUpdated = false;
+
+  size_t roomCount = this->rooms->getRoomCount();
+  for (size_t id = 0; id < roomCount; id++) {
+    t_room_feed* feed = getFeed(id);
+    feed->snapshotFrames.clear();
+
+    std::shared_ptr<const t_snapshot> snapshot = this->rooms->getRoom(id)->getPublishedSnapshot();
+    feed->isUpdated = snapshot && snapshot->tick != feed->lastTick;
+    if (!feed->isUpdated)
+      continue;
+
+    feed->snapshots.push(snapshot);
+    feed->lastTick = snapshot->tick;
+    isUpdated = true;
+  }
 
-  this->newConnections.clear();
+  return isUpdated;
 }
 
-void Server::removeClosedConnections() {
-  for (const int fd : closedConnections) {
-    for (auto it = connectedClients.begin(); it != connectedClients.end(); it++) {
-      if (it->fd == fd) {
-        connectedClients.erase(it);
-        break;
-      }
-    }
+// Delta against base, full state without one. The full state comes serialized with the snapshot,
+// and most clients share a base and an encoding, so each delta is built once per tick and reused.
+t_frame_buffer Server::constructSnapshotFrame(t_room_feed* feed, const t_snapshot* base, bool packBodies) {
+  const t_snapshot* snapshot = feed->snapshots.find(feed->lastTick);
+  if (!base)
+    return snapshot->frames[packBodies];
+
+  uint64_t key = (uint64_t)base->tick << 1 | packBodies;
+
+  for (const t_cached_frame& cached : feed->snapshotFrames) {
+    if (cached.key == key)
+      return cached.frame;
   }
 
-  closedConnections.clear();
+  flatbuffers::FlatBufferBuilder& builder = this->frameBuilder.start();
+  builder.Finish(serializeDelta(builder, this->serializeScratch, *base, *snapshot, packBodies));
+
+  feed->snapshotFrames.push_back({key, this->frameBuilder.finish()});
+  return feed->snapshotFrames.back().frame;
 }
 
-void Server::constructGameData() {
-  flatbuffers::FlatBufferBuilder builder(1024);
+void Server::broadcastGameData() {
+  // backwards, closing a client moves the last one into the current slot
+  for (size_t i = this->clientFds.size(); i-- > 0;)
+    sendGameData(this->clientFds[i]);
 
-  auto gameData = game->serializeGameData(builder);
-  builder.Finish(gameData);
+  sendDatagrams();
+}
 
-  gameBuffer.assign(builder.GetBufferPointer(), builder.GetBufferPointer() + builder.GetSize());
-  gameSizeNetwork = htonl(gameBuffer.size());
+// TCP, a delta against the last acked snapshot when the client supports it, the full state otherwise
+void Server::sendGameData(const int fd) {
+  Connection* connection = getConnection(fd);
+  if (!connection)
+    return;
 
-  iovGame[0].iov_base = &gameSizeNetwork;
-  iovGame[0].iov_len = sizeof(gameSizeNetwork);
-  iovGame[1].iov_base = gameBuffer.data();
-  iovGame[1].iov_len = gameBuffer.size();
+  t_room_feed* feed = getFeed(connection->getRoomId());
+  if (!feed->isUpdated)
+    return;
+
+  if (!connection->getIsMapSent()) {
+    sendLegacyMapData(fd);
+    if (!getConnection(fd))
+      return;
+  }
+
+  const t_snapshot* base = nullptr;
+  if (connection->getFeatures() & Feature_DeltaSnapshots)
+    base = feed->snapshots.find(connection->getAckedTick());
+  if (base && base->tick == feed->lastTick)
+    base = nullptr;
+
+  bool packBodies = connection->getFeatures() & Feature_PackedBodies;
+  t_frame_buffer frame = constructSnapshotFrame(feed, base, packBodies);
+
+  if (!canSendDatagram(connection, feed, frame))
+    return sendFrame(fd, frame, true);
+
+  if (!connection->getDatagramTick())
+    connection->setDatagramTick(feed->lastTick);
+
+  t_datagram datagram;
+  memset(&datagram.address, 0, sizeof(datagram.address));
+  datagram.address.sin_family = AF_INET;
+  datagram.address.sin_addr.s_addr = connection->getEndpoint() >> 16;
+  datagram.address.sin_port = connection->getEndpoint() & 0xFFFF;
+  datagram.frame = frame;
+  this->pendingDatagrams.push_back(datagram);
 }
 
-void Server::constructMapData(int fd) {
-  flatbuffers::FlatBufferBuilder builder(1024);
+// UDP once the client bound an endpoint. Acks have to keep coming back over TCP, a client that
+// stops seeing the datagrams (a firewall, a dead NAT mapping) is moved back to TCP for good.
+bool Server::canSendDatagram(Connection* connection, t_room_feed* feed, const t_frame_buffer& frame) {
+  if (!(connection->getFeatures() & Feature_UdpSnapshots) || !connection->getEndpoint() ||
+      connection->getIsDatagramBlocked())
+    return false;
+
+  uint32_t confirmed = std::max(connection->getAckedTick(), connection->getDatagramTick());
+  if (connection->getDatagramTick() && feed->lastTick - confirmed > SNAPSHOT_HISTORY) {
+    connection->setIsDatagramBlocked(true);
+    std::cout << "UDP snapshots unacked, back to TCP: " << connection->getFd() << std::endl;
+    return false;
+  }
+
+  return frame->size() - sizeof(uint32_t) <= MAX_SNAPSHOT_DATAGRAM;
+}
 
-  auto mapData = game->serializeMapData(builder, fd);
-  builder.Finish(mapData);
+// One sendmmsg per DATAGRAM_BATCH_SIZE clients. A full socket buffer drops the rest of the tick,
+// the next snapshot supersedes it anyway.
+void Server::sendDatagrams() {
+#ifdef __linux__
+  struct iovec iov[DATAGRAM_BATCH_SIZE];
+  struct mmsghdr messages[DATAGRAM_BATCH_SIZE];
+
+  size_t sent = 0;
+  while (sent < this->pendingDatagrams.size()) {
+    size_t count = std::min(this->pendingDatagrams.size() - sent, (size_t)DATAGRAM_BATCH_SIZE);
+
+    memset(messages, 0, sizeof(messages));
+    for (size_t i = 0; i < count; i++) {
+      t_datagram& datagram = this->pendingDatagrams[sent + i];
+      iov[i].iov_base = const_cast<uint8_t*>(datagram.frame->data()) + sizeof(uint32_t);
+      iov[i].iov_len = datagram.frame->size() - sizeof(uint32_t);
+      messages[i].msg_hdr.msg_iov = &iov[i];
+      messages[i].msg_hdr.msg_iovlen = 1;
+      messages[i].msg_hdr.msg_name = &datagram.address;
+      messages[i].msg_hdr.msg_namelen = sizeof(datagram.address);
+    }
 
-  mapBuffer.assign(builder.GetBufferPointer(), builder.GetBufferPointer() + builder.GetSize());
-  mapSizeNetwork = htonl(mapBuffer.size());
+    int n = sendmmsg(this->udpServerFd, messages, count, 0);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+      break;
+    // any other error belongs to the first datagram of the batch, skip it
+    sent += n > 0 ? n : 1;
+  }
+#else
+  for (const t_datagram& datagram : this->pendingDatagrams) {
+    ssize_t n = sendto(this->udpServerFd, datagram.frame->data() + sizeof(uint32_t),
+                       datagram.frame->size() - sizeof(uint32_t), 0, (const sockaddr*)&datagram.address,
+                       sizeof(datagram.address));
+    if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+      break;
+  }
+#endif
 
-  iovMap[0].iov_base = &mapSizeNetwork;
-  iovMap[0].iov_len = sizeof(mapSizeNetwork);
-  iovMap[1].iov_base = mapBuffer.data();
-  iovMap[1].iov_len = mapBuffer.size();
+  this->pendingDatagrams.clear();
+}
+
+// TCP, the player id goes ahead in a Welcome so the map the registry serialized is sent as is
+void Server::sendMapData(const int fd) {
+  Connection* connection = getConnection(fd);
+  if (!connection)
+    return;
+
+  connection->setIsMapSent(true);
+  bool packTiles = connection->getFeatures() & Feature_PackedMap;
+  const t_map& map = this->rooms->getRoom(connection->getRoomId())->getMap();
+
+  sendWelcome(fd);
+  if (getConnection(fd))
+    sendFrame(fd, packTiles ? map.packedFrame : map.frame, false);
+}
+
+// TCP, clients without Hello only read the player id from the map
+void Server::sendLegacyMapData(const int fd) {
+  Connection* connection = getConnection(fd);
+  if (!connection)
+    return;
+
+  connection->setIsMapSent(true);
+  const t_map& map = this->rooms->getRoom(connection->getRoomId())->getMap();
+
+  auto frame = std::make_shared<std::vector<uint8_t>>(*map.frame);
+  Packet* packet = GetMutablePacket(frame->data() + sizeof(uint32_t));
+  static_cast<MapData*>(packet->mutable_data())->mutate_player_id(fd);
+
+  sendFrame(fd, frame, false);
 }
 
 // TCP
-void Server::sendGameData(const int fd) const {
-  ssize_t bytesWritten = writev(fd, iovGame, 2);
-  if (bytesWritten == -1 && (errno == EAGAIN || EWOULDBLOCK))
-    std::cout << "Socket buffer is full, could not sent game data: " << fd << std::endl;
-  else if (bytesWritten == -1)
+void Server::sendWelcome(const int fd) {
+  flatbuffers::FlatBufferBuilder& builder = this->frameBuilder.start();
+
+  auto welcome = CreateWelcome(builder, fd, getConnection(fd)->getToken());
+  builder.Finish(CreatePacket(builder, MsgType_Welcome, MsgUnion_Welcome, welcome.Union()));
+
+  sendFrame(fd, this->frameBuilder.finish(), false);
+}
+
+void Server::sendFrame(const int fd, const t_frame_buffer& frame, bool isSnapshot) {
+  Connection* connection = getConnection(fd);
+  if (!connection)
+    return;
+
+  if (!connection->send(frame, isSnapshot)) {
     perror("write");
+    return closeConnection(fd);
+  }
+
+  if (connection->getPendingBytes() > this->sendQueueBudget) {
+    std::cout << "Client is too slow, send queue over budget: " << fd << std::endl;
+    return closeConnection(fd);
+  }
+
+  updateWriteInterest(connection);
 }
 
-// TCP
-void Server::sendMapData(const int fd) {
-  constructMapData(fd);
+void Server::flushConnection(const int fd) {
+  Connection* connection = getConnection(fd);
+  if (!connection)
+    return;
 
-  ssize_t bytesWritten = writev(fd, iovMap, 2);
-  if (bytesWritten == -1 && (errno == EAGAIN || EWOULDBLOCK))
-    std::cout << "Socket buffer is full, could not sent map data: " << fd << std::endl;
-  else if (bytesWritten == -1)
+  if (!connection->flush()) {
     perror("write");
+    return closeConnection(fd);
+  }
+
+  updateWriteInterest(connection);
+}
+
+// writable events are only needed while something is queued
+void Server::updateWriteInterest(Connection* connection) {
+  bool shouldWatch = connection->hasPendingData();
+  if (shouldWatch == connection->getIsWatchingWrite())
+    return;
+
+  int events = shouldWatch ? EVENT_READ | EVENT_WRITE : EVENT_READ;
+  if (this->eventLoop.modify(connection->getFd(), events))
+    connection->setIsWatchingWrite(shouldWatch);
 }
 
-// UDP
 void Server::receiveDataFromClient(const int fd) {
   if (fd == STDIN_FILENO)
-    throw "Server stopped by admin";
+    return receiveAdminCommand();
 
-  if (fd == this->tcpServerFd)
-    return acceptNewConnection();
+  if (fd == this->rooms->getUpdateNotifier().getFd())
+    return this->rooms->getUpdateNotifier().drain();
+
+  if (fd == this->tcpServerFd) {
+    this->hasPendingAccepts = true;
+    return;
+  }
 
-  if (fd == this->udpServerFd) {
-    char readBuf[10];
-    sockaddr_in clientAddr;
-    socklen_t clientAddrLen = sizeof(clientAddr);
+  if (fd == this->udpServerFd)
+    return receiveInputs();
 
-    int n = recvfrom(this->udpServerFd, readBuf, 2, 0, (sockaddr*)&clientAddr, &clientAddrLen);
-    if (n != 2) {
-      std::cout << "Failed to receive data from client" << std::endl;
-      return;
+  Connection* connection = getConnection(fd);
+  if (!connection)
+    return;
+
+  const uint8_t* data;
+  uint32_t size;
+  enum e_receive status;
+  // the socket is edge-triggered, read until it is drained but hand the packets out between
+  // reads so the buffer stays within MAX_RECEIVE_BYTES and a packet
+  do {
+    status = connection->receive();
+    if (status == RECEIVE_CLOSED) {
+      std::cout << "Closing connection" << std::endl;
+      return closeConnection(fd);
     }
 
-    uint32_t ip = clientAddr.sin_addr.s_addr;
+    // a reply may close the connection, fds are not reused before the next accept
+    while (getConnection(fd) && connection->nextPacket(data, size))
+      handleClientPacket(connection, data, size);
+  } while (status == RECEIVE_MORE && getConnection(fd));
+}
+
+// TCP, session control only, directions still arrive over UDP
+void Server::handleClientPacket(Connection* connection, const uint8_t* data, uint32_t size) {
+  flatbuffers::Verifier verifier(data, size);
+  if (!VerifyPacketBuffer(verifier)) {
+    std::cout << "Malformed packet from client: " << connection->getFd() << std::endl;
+    return;
+  }
 
-    auto it = this->addressToFd.find(ip);
-    if (it == this->addressToFd.end())
+  const Packet* packet = GetPacket(data);
+
+  // a client that says Hello steers with its token, a tokenless datagram from its ip is no longer it
+  if (const Hello* hello = packet->data_as_Hello()) {
+    releaseAddress(connection);
+    connection->setFeatures(hello->features() & SUPPORTED_FEATURES);
+    if (!connection->getIsMapSent())
+      sendMapData(connection->getFd());
+    return;
+  }
+
+  if (const Ack* ack = packet->data_as_Ack()) {
+    // acks may be reordered behind newer ones, never move the baseline back
+    uint32_t lastTick = getFeed(connection->getRoomId())->lastTick;
+    if (ack->tick() > connection->getAckedTick() && ack->tick() <= lastTick)
+      connection->setAckedTick(ack->tick());
+  }
+}
+
+// UDP
+// Drained INPUT_BATCH_SIZE datagrams per syscall where recvmmsg exists
+void Server::receiveInputs() {
+#ifdef __linux__
+  uint8_t buffers[INPUT_BATCH_SIZE][INPUT_BUFFER_SIZE];
+  sockaddr_in addresses[INPUT_BATCH_SIZE];
+  struct iovec iov[INPUT_BATCH_SIZE];
+  struct mmsghdr messages[INPUT_BATCH_SIZE];
+
+  while (true) {
+    memset(messages, 0, sizeof(messages));
+    for (int i = 0; i < INPUT_BATCH_SIZE; i++) {
+      iov[i].iov_base = buffers[i];
+      iov[i].iov_len = INPUT_BUFFER_SIZE;
+      messages[i].msg_hdr.msg_iov = &iov[i];
+      messages[i].msg_hdr.msg_iovlen = 1;
+      messages[i].msg_hdr.msg_name = &addresses[i];
+      messages[i].msg_hdr.msg_namelen = sizeof(addresses[i]);
+    }
+
+    int n = recvmmsg(this->udpServerFd, messages, INPUT_BATCH_SIZE, 0, nullptr);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
       return;
 
-    game->updateSnakeDirection(it->second, (int)readBuf[0]);
+    for (int i = 0; i < n; i++) {
+      size_t size = (messages[i].msg_hdr.msg_flags & MSG_TRUNC) ? 0 : messages[i].msg_len;
+      handleInput(buffers[i], size, addresses[i]);
+    }
+  }
+#else
+  uint8_t readBuf[INPUT_BUFFER_SIZE];
+  sockaddr_in clientAddr;
+  socklen_t clientAddrLen;
+
+  while (true) {
+    clientAddrLen = sizeof(clientAddr);
+    int n = recvfrom(this->udpServerFd, readBuf, sizeof(readBuf), 0, (sockaddr*)&clientAddr, &clientAddrLen);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n < 0)
+      return;
+
+    handleInput(readBuf, n, clientAddr);
+  }
+#endif
+}
+
+void Server::handleInput(const uint8_t* data, size_t size, const sockaddr_in& address) {
+  int fd = -1;
+
+  if (size == INPUT_SIZE || size == BIND_SIZE) {
+    uint32_t tokenNetwork;
+    memcpy(&tokenNetwork, data + size - sizeof(tokenNetwork), sizeof(tokenNetwork));
+    uint64_t endpoint = (uint64_t)address.sin_addr.s_addr << 16 | address.sin_port;
+    fd = findSessionFd(ntohl(tokenNetwork), endpoint);
+    if (size == BIND_SIZE)
+      return;
+  } else if (size == LEGACY_INPUT_SIZE) {
+    auto it = this->addressToFd.find(address.sin_addr.s_addr);
+    if (it != this->addressToFd.end())
+      fd = it->second;
+  } else {
+    std::cout << "Failed to receive data from client" << std::endl;
     return;
   }
 
-  std::cout << "Closing connection" << std::endl;
-  closeConnection(fd);
+  Connection* connection = getConnection(fd);
+  if (connection)
+    this->rooms->getRoom(connection->getRoomId())->updateSnakeDirection(fd, (int)data[0]);
+}
+
+// The bound endpoint is the fast path, a valid token from a new endpoint (NAT rebinding, a
+// reconnected socket) moves the binding over. Returns -1 for an unknown token.
+int Server::findSessionFd(uint32_t token, uint64_t endpoint) {
+  auto bound = this->endpointToFd.find(endpoint);
+  if (bound != this->endpointToFd.end()) {
+    Connection* connection = getConnection(bound->second);
+    if (connection && connection->getToken() == token)
+      return bound->second;
+  }
+
+  auto session = this->tokenToFd.find(token);
+  if (session == this->tokenToFd.end())
+    return -1;
+
+  Connection* connection = getConnection(session->second);
+  auto previous = this->endpointToFd.find(connection->getEndpoint());
+  if (previous != this->endpointToFd.end() && previous->second == session->second)
+    this->endpointToFd.erase(previous);
+
+  connection->setEndpoint(endpoint);
+  this->endpointToFd[endpoint] = session->second;
+  releaseAddress(connection);
+  return session->second;
+}
+
+// Drops the tokenless fallback of this connection, unless another one took the ip over since
+void Server::releaseAddress(const Connection* connection) {
+  auto address = this->addressToFd.find(connection->getAddress());
+  if (address != this->addressToFd.end() && address->second == connection->getFd())
+    this->addressToFd.erase(address);
+}
+
+// "stats" prints the tick latency histogram, anything else stops the server
+void Server::receiveAdminCommand() {
+  char readBuf[READ_BUFFER_SIZE];
+  ssize_t n = read(STDIN_FILENO, readBuf, sizeof(readBuf) - 1);
+  if (n <= 0)
+    throw "Server stopped by admin";
+
+  readBuf[n] = '\0';
+  if (strncmp(readBuf, "stats", 5) != 0)
+    throw "Server stopped by admin";
+
+  this->tickLatency.print(std::cout);
 }
 
 void Server::handleSocketError(const int fd) {
+  if (fd == STDIN_FILENO)
+    throw "Server stopped by admin";
+
   if (fd == this->tcpServerFd)
     throw "Server socket crashed";
 
+  Connection* connection = getConnection(fd);
+  if (!connection)
+    return;
+
+  // zerocopy completions are reported as errors, the socket itself may be fine
+  if (connection->getIsZerocopy() && connection->readCompletions())
+    return;
+
   std::cout << "Socket error: " << fd << std::endl;
   closeConnection(fd);
 }
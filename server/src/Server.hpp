@@ -1,13 +1,35 @@
 #ifndef SERVER_HPP
 #define SERVER_HPP
 
-#include "Game.hpp"
+#include "Connection.hpp"
+#include "EventLoop.hpp"
+#include "FrameBuilder.hpp"
+#include "LatencyHistogram.hpp"
+#include "RoomManager.hpp"
+#include "Snapshot.hpp"
+#include <random>
 
-class Game;
+typedef struct s_datagram {
+  sockaddr_in address;
+  t_frame_buffer frame; // only the payload is sent, datagrams need no length prefix
+} t_datagram;
+
+typedef struct s_cached_frame {
+  uint64_t key; // base tick and encoding
+  t_frame_buffer frame;
+} t_cached_frame;
+
+// The snapshots of one room as the network thread sees them
+typedef struct s_room_feed {
+  SnapshotHistory snapshots;
+  uint32_t lastTick;                          // tick of the newest snapshot, 0 before the first one
+  bool isUpdated;                             // a new snapshot arrived this round
+  std::vector<t_cached_frame> snapshotFrames; // deltas this tick, a handful of bases and encodings
+} t_room_feed;
 
 class Server {
 public:
-  Server(Game* game);
+  Server(RoomManager* rooms, size_t sendQueueBudget = SEND_QUEUE_BUDGET, bool isZerocopy = false);
   Server(const Server& obj) = delete;
   Server& operator=(const Server& obj) = delete;
   Server(Server&& obj) = delete;
@@ -17,32 +39,52 @@ public:
   void start();
 
 private:
-  Game* game;
+  RoomManager* rooms;
   int tcpServerFd;
   int udpServerFd;
-  std::vector<struct pollfd> connectedClients;
-  std::vector<struct pollfd> newConnections;
-  std::vector<int> closedConnections;
-  std::unordered_map<in_addr_t, int> addressToFd;
-  struct iovec iovGame[2];
-  struct iovec iovMap[2];
-  std::vector<uint8_t> mapBuffer;
-  uint32_t mapSizeNetwork;
-  std::vector<uint8_t> gameBuffer;
-  uint32_t gameSizeNetwork;
+  EventLoop eventLoop;
+  bool hasPendingAccepts;
+  size_t sendQueueBudget; // bytes a client may have queued before it is dropped
+  bool isZerocopy;        // MSG_ZEROCOPY on client sockets that support it
+  LatencyHistogram tickLatency;
+  std::vector<Connection*> connections; // indexed by fd
+  std::vector<int> clientFds;
+  std::unordered_map<in_addr_t, int> addressToFd; // inputs without a token, clients that never sent Hello
+  std::unordered_map<uint32_t, int> tokenToFd;
+  std::unordered_map<uint64_t, int> endpointToFd; // (ip, port) bound by its first valid token
+  std::mt19937 tokenGenerator;
+  std::vector<t_room_feed*> feeds; // indexed by room id
+  FrameBuilder frameBuilder;
+  t_serialize_scratch serializeScratch;
+  std::vector<t_datagram> pendingDatagrams; // this tick's UDP snapshots, sent in one batch
 
   void setupSocket(int socket);
   void initConnections();
-  void acceptNewConnection();
-  void addNewConnections();
+  void acceptNewConnections();
+  void addConnection(const int fd, int roomId, in_addr_t address);
   void closeConnection(const int fd);
-  void removeClosedConnections();
-  void sendGameData(const int fd) const;
+  Connection* getConnection(const int fd) const;
+  t_room_feed* getFeed(int roomId);
+  void broadcastGameData();
+  void sendGameData(const int fd);
   void sendMapData(const int fd);
+  void sendLegacyMapData(const int fd);
+  void sendWelcome(const int fd);
+  void sendFrame(const int fd, const t_frame_buffer& frame, bool isSnapshot);
+  bool canSendDatagram(Connection* connection, t_room_feed* feed, const t_frame_buffer& frame);
+  void sendDatagrams();
+  void flushConnection(const int fd);
+  void updateWriteInterest(Connection* connection);
   void receiveDataFromClient(const int fd);
+  void handleClientPacket(Connection* connection, const uint8_t* data, uint32_t size);
+  void receiveInputs();
+  void handleInput(const uint8_t* data, size_t size, const sockaddr_in& address);
+  int findSessionFd(uint32_t token, uint64_t endpoint);
+  void releaseAddress(const Connection* connection);
+  void receiveAdminCommand();
   void handleSocketError(const int fd);
-  void constructGameData();
-  void constructMapData(int fd);
+  bool constructGameData();
+  t_frame_buffer constructSnapshotFrame(t_room_feed* feed, const t_snapshot* base, bool packBodies);
 };
 
 #endif
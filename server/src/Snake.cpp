@@ -1,113 +1,138 @@
 #include "Snake.hpp"
-#include "Game.hpp"
-
-Snake::Snake(Game* game) : game(game), direction(UP), isDirectionSet(false), state(State_Idle), score(0) {
-  t_coordinates c;
-
-  c.x = game->getWidth() / 2;
-  c.y = game->getHeight() / 2;
-  body.push_front(c);
-  c.y = game->getHeight() / 2 + 1;
-  body.push_back(c);
-  c.y = game->getHeight() / 2 + 2;
-  body.push_back(c);
-  c.y = game->getHeight() / 2 + 3;
-  body.push_back(c);
-}
 
-Snake::~Snake() { std::cout << "Snake destructor" << std::endl; }
+#define SPAWN_ATTEMPTS 8
 
-void Snake::moveSnake(std::vector<std::string>* gameField) {
-  auto currentHead = body.front();
-  auto currentTail = body.back();
+Snake::Snake(int id, size_t initialLength)
+    : id(id), initialLength(initialLength), direction(UP), pendingCount(0), state(State_Idle), score(0) {}
 
-  if (state == State_Alive) {
-    currentHead = moveHead(currentHead.x, currentHead.y, gameField);
-    if (state == State_Dead)
-      return;
+Snake::~Snake() { std::cout << "Snake destructor" << std::endl; }
 
-    body.push_front({currentHead.x, currentHead.y});
+static const int stepX[] = {0, 0, -1, 1}; // by e_direction
+static const int stepY[] = {-1, 1, 0, 0};
 
-    if ((*gameField)[currentHead.y][currentHead.x] == FOOD_TILE) {
-      game->removeFood(currentHead.x, currentHead.y);
-      score += 1;
-    } else {
-      (*gameField)[currentTail.y][currentTail.x] = FLOOR_TILE;
-      body.pop_back();
-      currentTail = body.back();
+// First direction, UP included, whose next cell is free. Fails when the head is boxed in.
+static bool findOpenDirection(const Field* gameField, const t_coordinates& head, enum e_direction& found) {
+  for (int dir = UP; dir <= RIGHT; dir++) {
+    if (gameField->isFree(head.x + stepX[dir], head.y + stepY[dir])) {
+      found = (enum e_direction)dir;
+      return true;
     }
   }
+  return false;
+}
 
-  for (const auto& segment : body)
-    (*gameField)[segment.y][segment.x] = BODY_TILE;
+// Head on a random free cell with a free one ahead, so the first move does not run off the field
+// or into a wall. The body trails behind it as far as the floor allows, segments that do not fit
+// are stacked on the last one and uncoil as the snake moves. After SPAWN_ATTEMPTS boxed-in cells
+// the last one is taken anyway, the field is about full.
+void Snake::spawn(Field* gameField, std::mt19937& random) {
+  t_coordinates segment;
+  for (int attempt = 0; attempt < SPAWN_ATTEMPTS; attempt++) {
+    if (!gameField->pickFreeCell(segment.x, segment.y, random))
+      return;
+    if (findOpenDirection(gameField, segment, direction))
+      break;
+  }
 
-  (*gameField)[currentHead.y][currentHead.x] = HEAD_TILE;
-  (*gameField)[currentTail.y][currentTail.x] = TAIL_TILE;
+  body.push_back(segment);
+  while (body.size() < initialLength) {
+    if (gameField->isFree(segment.x - stepX[direction], segment.y - stepY[direction])) {
+      segment.x -= stepX[direction];
+      segment.y -= stepY[direction];
+    }
+    body.push_back(segment);
+  }
 
-  isDirectionSet = false;
+  // claimed right away so the next snake spawning this tick does not land on it
+  for (const auto& part : body)
+    gameField->setTile(part.x, part.y, BODY_TILE, id);
+  // ends painted as advance() leaves them, a snake may follow this tail on the first tick
+  gameField->setTile(body.back().x, body.back().y, TAIL_TILE, id);
+  gameField->setTile(body.front().x, body.front().y, HEAD_TILE, id);
 }
 
-t_coordinates Snake::moveHead(int currentX, int currentY, std::vector<std::string>* gameField) {
-  switch (direction) {
-  case UP:
-    if (currentY > 0)
-      currentY -= 1;
-    else
-      state = State_Dead;
-    break;
-  case DOWN:
-    if (currentY < game->getHeight() - 1)
-      currentY += 1;
-    else
-      state = State_Dead;
-    break;
-  case LEFT:
-    if (currentX > 0)
-      currentX -= 1;
-    else
-      state = State_Dead;
-    break;
-  case RIGHT:
-    if (currentX < game->getWidth() - 1)
-      currentX += 1;
-    else
-      state = State_Dead;
-  }
+// The head was already checked by Game::resolveMoves. Only the cells that change are repainted:
+// the old head becomes body, the tail moves up unless the snake eats.
+void Snake::advance(Field* gameField, const t_coordinates& newHead, bool eats) {
+  t_coordinates oldHead = body.front();
+  t_coordinates oldTail = body.back();
+  bool isVacating = isTailVacating(eats);
+
+  body.push_front(newHead);
+  if (eats)
+    score += 1;
+  else
+    body.pop_back();
+
+  gameField->setTile(oldHead.x, oldHead.y, BODY_TILE, id);
+  if (isVacating && gameField->getOwner(oldTail.x, oldTail.y) == id)
+    gameField->setTile(oldTail.x, oldTail.y, FLOOR_TILE);
+
+  gameField->setTile(body.back().x, body.back().y, TAIL_TILE, id);
+  gameField->setTile(newHead.x, newHead.y, HEAD_TILE, id);
+}
 
-  char tile = (*gameField)[currentY][currentX];
-  if (tile == BODY_TILE || tile == HEAD_TILE || tile == WALL_HORIZ_TILE || tile == WALL_VERTI_TILE)
-    state = State_Dead;
+void Snake::kill() { state = State_Dead; }
 
-  return {currentX, currentY};
+// Segments of a fresh snake are stacked on its tail until it uncoils, the cell stays covered
+bool Snake::isTailVacating(bool eats) const {
+  return !eats && body.size() > 1 && (body[body.size() - 2].x != body.back().x ||
+                                      body[body.size() - 2].y != body.back().y);
 }
 
+// Queued and played one per tick, so a quick "up then left" is not lost
 void Snake::setDirection(const int newDir) {
+  if (newDir < UP || newDir > RIGHT)
+    return;
+
   if (state == State_Idle)
     state = State_Alive;
 
-  if (isDirectionSet)
-	return;
-
-  enum e_direction dir = (enum e_direction)newDir;
-  if ((dir == UP || dir == DOWN) && (direction == DOWN || direction == UP))
-    return;
-  if ((dir == RIGHT || dir == LEFT) && (direction == RIGHT || direction == LEFT))
+  if (pendingCount == DIRECTION_QUEUE_SIZE)
     return;
 
-  direction = dir;
-  isDirectionSet = true;
+  pendingDirections[pendingCount++] = (enum e_direction)newDir;
   std::cout << "Received " << std::endl;
 }
 
-void Snake::cleanup(std::vector<std::string>* gameField) {
-  for (const auto& segment : body)
-    (*gameField)[segment.y][segment.x] = FLOOR_TILE;
+static bool isTurn(enum e_direction from, enum e_direction to) {
+  bool fromVertical = from == UP || from == DOWN;
+  bool toVertical = to == UP || to == DOWN;
+  return fromVertical != toVertical;
+}
+
+// Checked against the direction at consume time, a reversal or repeat is skipped without
+// costing the tick. Returns the direction to move in this tick.
+enum e_direction Snake::consumeDirection() {
+  size_t consumed = 0;
+  while (consumed < pendingCount) {
+    enum e_direction dir = pendingDirections[consumed++];
+    if (isTurn(direction, dir)) {
+      direction = dir;
+      break;
+    }
+  }
+
+  for (size_t i = consumed; i < pendingCount; i++)
+    pendingDirections[i - consumed] = pendingDirections[i];
+  pendingCount -= consumed;
+  return direction;
+}
+
+// Snakes spawn on the same cells, only the ones still owned by this snake are cleared
+void Snake::cleanup(Field* gameField) {
+  for (const auto& segment : body) {
+    if (gameField->getOwner(segment.x, segment.y) == id)
+      gameField->setTile(segment.x, segment.y, FLOOR_TILE);
+  }
 }
 
+int Snake::getId() const { return id; }
+
 int Snake::getScore() const { return score; }
 
 t_coordinates Snake::getHead() const { return body.front(); }
 
 State Snake::getState() const { return state; }
 
-std::list<t_coordinates> Snake::getBody() const { return body; }
\ No newline at end of file
+const SnakeBody& Snake::getBody() const { return body; }
\ No newline at end of file
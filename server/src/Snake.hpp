@@ -2,37 +2,43 @@
 #define SNAKE_HPP
 
 #include "../includes/nibbler.hpp"
-#include "Game.hpp"
+#include "Field.hpp"
+#include "SnakeBody.hpp"
 
-class Game;
+#define DIRECTION_QUEUE_SIZE 3
 
 class Snake {
 public:
-  Snake(Game* game);
+  Snake(int id, size_t initialLength = SNAKE_INITIAL_LENGTH);
   Snake(const Snake& obj) = delete;
   Snake& operator=(const Snake& obj) = delete;
   Snake(Snake&& obj) = delete;
   Snake& operator=(Snake&& obj) = delete;
   ~Snake();
 
-  void moveSnake(std::vector<std::string>* gameField);
-  void cleanup(std::vector<std::string>* gameField);
+  void spawn(Field* gameField, std::mt19937& random);
+  void advance(Field* gameField, const t_coordinates& newHead, bool eats);
+  void kill();
+  void cleanup(Field* gameField);
   void setDirection(const int newDir);
+  enum e_direction consumeDirection();
 
+  int getId() const;
   int getScore() const;
   State getState() const;
   t_coordinates getHead() const;
-  std::list<t_coordinates> getBody() const;
+  const SnakeBody& getBody() const;
+  bool isTailVacating(bool eats) const;
 
 private:
-  Game* game;
-  std::list<t_coordinates> body;
+  int id; // owner of the cells the body covers
+  size_t initialLength;
+  SnakeBody body;
   enum e_direction direction;
-  bool isDirectionSet;
+  enum e_direction pendingDirections[DIRECTION_QUEUE_SIZE]; // oldest first
+  size_t pendingCount;
   State state;
   int score;
-
-  t_coordinates moveHead(int currentX, int currentY, std::vector<std::string>* gameField);
 };
 
 #endif
@@ -0,0 +1,39 @@
+#include "SnakeBody.hpp"
+
+SnakeBody::SnakeBody()
+    : segments(SNAKE_BODY_INITIAL_CAPACITY), mask(SNAKE_BODY_INITIAL_CAPACITY - 1), head(0), length(0) {}
+
+SnakeBody::~SnakeBody() {}
+
+void SnakeBody::push_front(const t_coordinates& segment) {
+  if (this->length == this->segments.size())
+    grow();
+
+  this->head = (this->head - 1) & this->mask;
+  this->segments[this->head] = segment;
+  this->length++;
+}
+
+void SnakeBody::push_back(const t_coordinates& segment) {
+  if (this->length == this->segments.size())
+    grow();
+
+  this->segments[(this->head + this->length) & this->mask] = segment;
+  this->length++;
+}
+
+void SnakeBody::pop_back() {
+  if (this->length)
+    this->length--;
+}
+
+// Unrolls the ring into twice the storage, head back at slot 0
+void SnakeBody::grow() {
+  std::vector<t_coordinates> grown(this->segments.size() * 2);
+  for (size_t i = 0; i < this->length; i++)
+    grown[i] = (*this)[i];
+
+  this->segments.swap(grown);
+  this->mask = this->segments.size() - 1;
+  this->head = 0;
+}
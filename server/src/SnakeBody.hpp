@@ -0,0 +1,71 @@
+#ifndef SNAKE_BODY_HPP
+#define SNAKE_BODY_HPP
+
+#include "../includes/nibbler.hpp"
+#include <iterator>
+
+#define SNAKE_BODY_INITIAL_CAPACITY 16
+
+// Segments in a contiguous ring, head first. Moving is a push_front and a pop_back on the
+// same storage, which only grows (doubling) when the snake outgrows it.
+class SnakeBody {
+public:
+  class const_iterator {
+  public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = t_coordinates;
+    using difference_type = std::ptrdiff_t;
+    using pointer = const t_coordinates*;
+    using reference = const t_coordinates&;
+
+    const_iterator(const SnakeBody* body, size_t i) : body(body), i(i) {}
+
+    reference operator*() const { return (*body)[i]; }
+    pointer operator->() const { return &(*body)[i]; }
+    const_iterator& operator++() {
+      ++i;
+      return *this;
+    }
+    const_iterator operator++(int) {
+      const_iterator previous = *this;
+      ++i;
+      return previous;
+    }
+    bool operator==(const const_iterator& other) const { return i == other.i; }
+    bool operator!=(const const_iterator& other) const { return i != other.i; }
+
+  private:
+    const SnakeBody* body;
+    size_t i;
+  };
+
+  SnakeBody();
+  SnakeBody(const SnakeBody& obj) = delete;
+  SnakeBody& operator=(const SnakeBody& obj) = delete;
+  SnakeBody(SnakeBody&& obj) = delete;
+  SnakeBody& operator=(SnakeBody&& obj) = delete;
+  ~SnakeBody();
+
+  void push_front(const t_coordinates& segment);
+  void push_back(const t_coordinates& segment);
+  void pop_back();
+
+  size_t size() const { return this->length; }
+  bool empty() const { return !this->length; }
+  const t_coordinates& front() const { return (*this)[0]; }
+  const t_coordinates& back() const { return (*this)[this->length - 1]; }
+  const t_coordinates& operator[](size_t i) const { return this->segments[(this->head + i) & this->mask]; }
+
+  const_iterator begin() const { return const_iterator(this, 0); }
+  const_iterator end() const { return const_iterator(this, this->length); }
+
+private:
+  std::vector<t_coordinates> segments; // capacity is a power of two
+  size_t mask;
+  size_t head; // slot of segment 0
+  size_t length;
+
+  void grow();
+};
+
+#endif
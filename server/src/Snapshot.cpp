@@ -0,0 +1,200 @@
+#include "Snapshot.hpp"
+
+#define MIN_PACKED_BODY 8 // shorter bodies are smaller as plain positions than with the table overhead
+#define FNV_OFFSET_BASIS 14695981039346656037ULL
+#define FNV_PRIME 1099511628211ULL
+
+static bool samePosition(const t_coordinates& a, const t_coordinates& b) { return a.x == b.x && a.y == b.y; }
+
+// A moving snake only gains segments in front and loses them at the tail. Finds how many of
+// each since base, fails when body does not continue base (e.g. an id reused by a new snake).
+static bool diffBody(const std::vector<t_coordinates>& base, const std::vector<t_coordinates>& body, size_t& grown,
+                     size_t& trimmed) {
+  if (base.empty())
+    return false;
+
+  size_t oldHead = 0;
+  while (oldHead < body.size() && !samePosition(body[oldHead], base.front()))
+    oldHead++;
+
+  size_t kept = body.size() - oldHead;
+  if (!kept || kept > base.size())
+    return false;
+
+  for (size_t i = 0; i < kept; i++) {
+    if (!samePosition(body[oldHead + i], base[i]))
+      return false;
+  }
+
+  grown = oldHead;
+  trimmed = base.size() - kept;
+  return true;
+}
+
+static bool stepDirection(const t_coordinates& from, const t_coordinates& to, uint8_t& direction) {
+  int dx = to.x - from.x;
+  int dy = to.y - from.y;
+
+  if (dx == 0 && dy == -1)
+    direction = Direction_Up;
+  else if (dx == 0 && dy == 1)
+    direction = Direction_Down;
+  else if (dx == -1 && dy == 0)
+    direction = Direction_Left;
+  else if (dx == 1 && dy == 0)
+    direction = Direction_Right;
+  else
+    return false;
+  return true;
+}
+
+static bool isConnected(const std::vector<t_coordinates>& body) {
+  uint8_t direction;
+  for (size_t i = 1; i < body.size(); i++) {
+    if (!stepDirection(body[i - 1], body[i], direction))
+      return false;
+  }
+  return true;
+}
+
+// Head plus 2 bits per following segment, null when plain positions are to be sent instead.
+// The directions are written straight into the builder.
+static flatbuffers::Offset<PackedBody> packBody(flatbuffers::FlatBufferBuilder& builder,
+                                                const std::vector<t_coordinates>& body) {
+  if (body.size() < MIN_PACKED_BODY || !isConnected(body))
+    return 0;
+
+  uint8_t* directions;
+  size_t byteCount = (body.size() - 1 + 3) / 4;
+  auto directionsData = builder.CreateUninitializedVector(byteCount, &directions);
+  memset(directions, 0, byteCount);
+
+  for (size_t i = 1; i < body.size(); i++) {
+    uint8_t direction;
+    stepDirection(body[i - 1], body[i], direction);
+    directions[(i - 1) / 4] |= direction << ((i - 1) % 4 * 2);
+  }
+
+  Pos head(body.front().x, body.front().y);
+  return CreatePackedBody(builder, &head, body.size(), directionsData);
+}
+
+static flatbuffers::Offset<flatbuffers::Vector<const Pos*>>
+serializePositions(flatbuffers::FlatBufferBuilder& builder, const std::vector<t_coordinates>& positions,
+                   size_t count) {
+  Pos* structs;
+  auto positionsData = builder.CreateUninitializedVectorOfStructs(count, &structs);
+
+  for (size_t i = 0; i < count; i++)
+    structs[i] = Pos(positions[i].x, positions[i].y);
+
+  return positionsData;
+}
+
+static flatbuffers::Offset<flatbuffers::Vector<const Pos*>> serializeFood(flatbuffers::FlatBufferBuilder& builder,
+                                                                           const t_snapshot& snapshot) {
+  return serializePositions(builder, snapshot.food, snapshot.food.size());
+}
+
+flatbuffers::Offset<Packet> serializeSnapshot(flatbuffers::FlatBufferBuilder& builder,
+                                              t_serialize_scratch& scratch, const t_snapshot& snapshot,
+                                              bool packBodies) {
+  std::vector<flatbuffers::Offset<SnakeObj>>& snakesVec = scratch.snakes;
+  snakesVec.clear();
+
+  for (const auto& snake : snapshot.snakes) {
+    flatbuffers::Offset<PackedBody> packed = packBodies ? packBody(builder, snake.body) : 0;
+    flatbuffers::Offset<flatbuffers::Vector<const Pos*>> body = 0;
+    if (packed.IsNull())
+      body = serializePositions(builder, snake.body, snake.body.size());
+
+    snakesVec.emplace_back(CreateSnakeObj(builder, snake.id, snake.score, snake.state, body, packed));
+  }
+
+  auto snakesData = builder.CreateVector(snakesVec);
+  auto foodData = serializeFood(builder, snapshot);
+  auto gameData = CreateGameData(builder, snakesData, foodData, snapshot.tick);
+  return CreatePacket(builder, MsgType_Game, MsgUnion_GameData, gameData.Union());
+}
+
+flatbuffers::Offset<Packet> serializeDelta(flatbuffers::FlatBufferBuilder& builder,
+                                           t_serialize_scratch& scratch, const t_snapshot& base,
+                                           const t_snapshot& snapshot, bool packBodies) {
+  std::vector<flatbuffers::Offset<SnakeDelta>>& snakesVec = scratch.deltas;
+  snakesVec.clear();
+
+  size_t baseIndex = 0;
+  for (const auto& snake : snapshot.snakes) {
+    while (baseIndex < base.snakes.size() && base.snakes[baseIndex].id < snake.id)
+      baseIndex++;
+
+    size_t grown = snake.body.size();
+    size_t trimmed = 0;
+    bool reset = true;
+    if (baseIndex < base.snakes.size() && base.snakes[baseIndex].id == snake.id)
+      reset = !diffBody(base.snakes[baseIndex].body, snake.body, grown, trimmed);
+    if (reset) {
+      grown = snake.body.size();
+      trimmed = 0;
+    }
+
+    flatbuffers::Offset<PackedBody> packed = reset && packBodies ? packBody(builder, snake.body) : 0;
+    flatbuffers::Offset<flatbuffers::Vector<const Pos*>> head = 0;
+    if (packed.IsNull())
+      head = serializePositions(builder, snake.body, grown);
+
+    snakesVec.emplace_back(
+        CreateSnakeDelta(builder, snake.id, snake.score, snake.state, head, trimmed, reset, packed));
+  }
+
+  auto snakesData = builder.CreateVector(snakesVec);
+  auto foodData = serializeFood(builder, snapshot);
+  auto gameDelta = CreateGameDelta(builder, snapshot.tick, base.tick, snakesData, foodData);
+  return CreatePacket(builder, MsgType_Delta, MsgUnion_GameDelta, gameDelta.Union());
+}
+
+static void hashValue(uint64_t& hash, int64_t value) {
+  for (size_t i = 0; i < sizeof(value); i++) {
+    hash ^= (uint8_t)(value >> (i * 8));
+    hash *= FNV_PRIME;
+  }
+}
+
+// FNV-1a over what the game decides, the clock and the frames left out, so two runs that agree on
+// every tick agree on the digest
+uint64_t hashSnapshot(const t_snapshot& snapshot) {
+  uint64_t hash = FNV_OFFSET_BASIS;
+
+  hashValue(hash, snapshot.tick);
+  for (const t_snake_state& snake : snapshot.snakes) {
+    hashValue(hash, snake.id);
+    hashValue(hash, snake.score);
+    hashValue(hash, snake.state);
+    hashValue(hash, snake.body.size());
+    for (const t_coordinates& segment : snake.body) {
+      hashValue(hash, segment.x);
+      hashValue(hash, segment.y);
+    }
+  }
+  for (const t_coordinates& food : snapshot.food) {
+    hashValue(hash, food.x);
+    hashValue(hash, food.y);
+  }
+  return hash;
+}
+
+SnapshotHistory::SnapshotHistory() {}
+
+SnapshotHistory::~SnapshotHistory() {}
+
+// Replaces the snapshot SNAPSHOT_HISTORY ticks older, which goes back to the game thread's pool
+void SnapshotHistory::push(const std::shared_ptr<const t_snapshot>& snapshot) {
+  slots[snapshot->tick % SNAPSHOT_HISTORY] = snapshot;
+}
+
+const t_snapshot* SnapshotHistory::find(uint32_t tick) const {
+  const std::shared_ptr<const t_snapshot>& slot = slots[tick % SNAPSHOT_HISTORY];
+  if (!tick || !slot || slot->tick != tick)
+    return nullptr;
+  return slot.get();
+}
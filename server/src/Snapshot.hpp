@@ -0,0 +1,56 @@
+#ifndef SNAPSHOT_HPP
+#define SNAPSHOT_HPP
+
+#include "../includes/nibbler.hpp"
+
+#define SNAPSHOT_HISTORY 32
+#define SNAPSHOT_ENCODINGS 2 // plain and packed bodies
+
+typedef struct s_snake_state {
+  int id;
+  int score;
+  State state;
+  std::vector<t_coordinates> body; // head first
+} t_snake_state;
+
+// One tick as the game thread published it, never modified afterwards
+typedef struct s_snapshot {
+  uint32_t tick;                     // 0 means empty
+  int64_t simulatedAt;               // steady clock, ns
+  std::vector<t_snake_state> snakes; // sorted by id
+  std::vector<t_coordinates> food;
+  t_frame_buffer frames[SNAPSHOT_ENCODINGS]; // full state, indexed by packBodies
+} t_snapshot;
+
+// Offsets collected before their vector can be written, kept so a steady tick allocates nothing
+typedef struct s_serialize_scratch {
+  std::vector<flatbuffers::Offset<SnakeObj>> snakes;
+  std::vector<flatbuffers::Offset<SnakeDelta>> deltas;
+} t_serialize_scratch;
+
+flatbuffers::Offset<Packet> serializeSnapshot(flatbuffers::FlatBufferBuilder& builder,
+                                              t_serialize_scratch& scratch, const t_snapshot& snapshot,
+                                              bool packBodies);
+flatbuffers::Offset<Packet> serializeDelta(flatbuffers::FlatBufferBuilder& builder,
+                                           t_serialize_scratch& scratch, const t_snapshot& base,
+                                           const t_snapshot& snapshot, bool packBodies);
+uint64_t hashSnapshot(const t_snapshot& snapshot);
+
+// The last SNAPSHOT_HISTORY broadcast snapshots, used as delta baselines
+class SnapshotHistory {
+public:
+  SnapshotHistory();
+  SnapshotHistory(const SnapshotHistory& obj) = delete;
+  SnapshotHistory& operator=(const SnapshotHistory& obj) = delete;
+  SnapshotHistory(SnapshotHistory&& obj) = delete;
+  SnapshotHistory& operator=(SnapshotHistory&& obj) = delete;
+  ~SnapshotHistory();
+
+  void push(const std::shared_ptr<const t_snapshot>& snapshot);
+  const t_snapshot* find(uint32_t tick) const;
+
+private:
+  std::shared_ptr<const t_snapshot> slots[SNAPSHOT_HISTORY];
+};
+
+#endif
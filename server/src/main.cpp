@@ -1,6 +1,7 @@
 #include "../includes/nibbler.hpp"
-#include "Game.hpp"
+#include "RoomManager.hpp"
 #include "Server.hpp"
+#include <signal.h>
 
 void onerror(const char* msg) {
   write(STDERR_FILENO, msg, strlen(msg));
@@ -18,16 +19,38 @@ int main(int argc, char** argv) {
 
   std::string mapPath = argc == 4 ? argv[3] : "";
 
-  Game* game = new Game(height, width, mapPath);
-  Server* server = new Server(game);
-
-  std::thread gameThread(&Game::start, game);
+  // a client vanishing mid-write must not kill the server
+  signal(SIGPIPE, SIG_IGN);
+
+  // one tick worker per core unless NIBBLER_WORKERS says otherwise, the clock thread is one of them
+  const char* workers = getenv("NIBBLER_WORKERS");
+  size_t workerCount = workers ? atoi(workers) : std::thread::hardware_concurrency();
+
+  // NIBBLER_SEED fixes the draws of every room, printed either way so any run can be played again.
+  // NIBBLER_REPLAY=path records the inputs of every tick there, for nibbler_replay.
+  const char* seedValue = getenv("NIBBLER_SEED");
+  std::random_device device;
+  uint64_t seed = seedValue ? strtoull(seedValue, NULL, 10) : ((uint64_t)device() << 32) | device();
+  std::cout << "Seed: " << seed << std::endl;
+  const char* replayPath = getenv("NIBBLER_REPLAY");
+
+  RoomManager* rooms = nullptr;
+  try {
+    rooms = new RoomManager(height, width, mapPath, workerCount, seed, replayPath ? replayPath : "");
+  } catch (const char* err) {
+    onerror(err);
+  }
+  // NIBBLER_ZEROCOPY=1 lets the kernel send TCP frames straight from the shared buffers
+  const char* zerocopy = getenv("NIBBLER_ZEROCOPY");
+  Server* server = new Server(rooms, SEND_QUEUE_BUDGET, zerocopy && strcmp(zerocopy, "0") != 0);
+
+  std::thread gameThread(&RoomManager::start, rooms);
 
   server->start();
 
   if (gameThread.joinable())
     gameThread.join();
 
-  delete game;
   delete server;
+  delete rooms;
 }